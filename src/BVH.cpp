@@ -0,0 +1,452 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "BVH.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if HAVE_OPENMP
+#  include <omp.h>
+#endif
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+struct BVH::BuildData
+{
+    /// minimum points of the primitives' bounding boxes
+    const std::vector<vec3>& bb_min;
+    /// maximum points of the primitives' bounding boxes
+    const std::vector<vec3>& bb_max;
+    /// centers of the primitives' bounding boxes
+    std::vector<vec3> centroids;
+    /// how to split the nodes
+    Quality quality;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// half the surface area of the box (_bb_min, _bb_max), or 0 if it is empty
+static double half_area(const vec3& _bb_min, const vec3& _bb_max)
+{
+    const vec3 d = _bb_max - _bb_min;
+    if (d[0] < 0 || d[1] < 0 || d[2] < 0) return 0.0;
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max,
+                Quality _quality)
+{
+    Profiler::Scope scope("build");
+    PerfCounters::Scope counters("build");
+    assert(_bb_min.size() == _bb_max.size());
+
+    nodes_.clear();
+    primitives_.clear();
+    if (_bb_min.empty()) return;
+
+    const unsigned int n = static_cast<unsigned int>(_bb_min.size());
+
+    // splits are decided on the primitives' bounding box centers
+    BuildData data{_bb_min, _bb_max, std::vector<vec3>(n), _quality};
+    primitives_.resize(n);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        data.centroids[i] = 0.5 * (_bb_min[i] + _bb_max[i]);
+        primitives_[i]    = i;
+    }
+
+    // a binary tree with at least one primitive per leaf has < 2n nodes
+    nodes_.reserve(2 * n);
+
+    // Start a team of threads for the build tasks, unless we already are
+    // part of one (e.g. when several meshes are built concurrently). Even a
+    // serialized parallel region would bind our tasks to a new team of one.
+#if HAVE_OPENMP
+    if (!omp_in_parallel() && n > PARALLEL_BUILD_SIZE)
+    {
+#       pragma omp parallel
+#       pragma omp single
+        build_recursive(0, n, 1, data, nodes_);
+    }
+    else
+#endif
+    build_recursive(0, n, 1, data, nodes_);
+
+    nodes_.shrink_to_fit();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::build_recursive(unsigned int _begin, unsigned int _end,
+                          unsigned int _depth, const BuildData& _data,
+                          std::vector<Node>& _nodes)
+{
+    const unsigned int index = static_cast<unsigned int>(_nodes.size());
+    _nodes.emplace_back();
+
+    // bounding box of the primitives and of their centers
+    Node node;
+    node.bb_min = vec3(std::numeric_limits<Scalar>::max());
+    node.bb_max = vec3(std::numeric_limits<Scalar>::lowest());
+    vec3 c_min  = node.bb_min;
+    vec3 c_max  = node.bb_max;
+    for (unsigned int i = _begin; i < _end; ++i)
+    {
+        const unsigned int p = primitives_[i];
+        node.bb_min = min(node.bb_min, _data.bb_min[p]);
+        node.bb_max = max(node.bb_max, _data.bb_max[p]);
+        c_min = min(c_min, _data.centroids[p]);
+        c_max = max(c_max, _data.centroids[p]);
+    }
+
+    const unsigned int n = _end - _begin;
+    const vec3 extent = c_max - c_min;
+    int axis = 0;
+    if (extent[1] > extent[axis]) axis = 1;
+    if (extent[2] > extent[axis]) axis = 2;
+
+    // Small nodes become leaves, unless the SAH finds a split that pays off.
+    // Large nodes are always split: at the SAH optimum if there is one, at
+    // the median otherwise. Deep in the tree we only split at the median,
+    // which bounds the depth by MAX_DEPTH.
+    const double area      = half_area(node.bb_min, node.bb_max);
+    const double leaf_cost = n <= MAX_LEAF_SIZE ? double(n) : std::numeric_limits<double>::max();
+    const bool   use_sah   = _data.quality != MEDIAN && area > 0 && _depth < MAX_DEPTH / 2;
+
+    unsigned int mid = 0;
+    bool split = false;
+    if (n > 1 && use_sah)
+    {
+        split = (_data.quality == SWEEP_SAH)
+            ? split_sweep(_begin, _end, area, leaf_cost, _data, mid)
+            : split_binned(_begin, _end, c_min, c_max, area, leaf_cost, _data, mid);
+    }
+    if (!split && n > MAX_LEAF_SIZE)
+    {
+        mid   = split_median(_begin, _end, axis, _data);
+        split = true;
+    }
+
+    if (!split)
+    {
+        node.first = _begin;
+        node.count = n;
+        _nodes[index] = node;
+        return;
+    }
+
+    node.count = 0;
+
+    if (_end - mid <= PARALLEL_BUILD_SIZE)
+    {
+        build_recursive(_begin, mid, _depth + 1, _data, _nodes);
+        node.first = static_cast<unsigned int>(_nodes.size());
+        build_recursive(mid, _end, _depth + 1, _data, _nodes);
+        _nodes[index] = node;
+        return;
+    }
+
+    // Build the large second subtree into its own array in a separate task,
+    // then append it. The children work on disjoint ranges of primitives_,
+    // and the array is appended in the same place whether the task ran in
+    // parallel or not, so the result is deterministic.
+    std::vector<Node> right_nodes;
+#if HAVE_OPENMP
+#  pragma omp task default(shared)
+#endif
+    build_recursive(mid, _end, _depth + 1, _data, right_nodes);
+
+    build_recursive(_begin, mid, _depth + 1, _data, _nodes);
+
+#if HAVE_OPENMP
+#  pragma omp taskwait
+#endif
+
+    const unsigned int offset = static_cast<unsigned int>(_nodes.size());
+    for (Node& child : right_nodes)
+    {
+        if (!child.count) child.first += offset;
+    }
+    _nodes.insert(_nodes.end(), right_nodes.begin(), right_nodes.end());
+
+    node.first = offset;
+    _nodes[index] = node;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int BVH::split_median(unsigned int _begin, unsigned int _end,
+                               int _axis, const BuildData& _data)
+{
+    const unsigned int mid = _begin + (_end - _begin) / 2;
+    std::nth_element(primitives_.begin() + _begin,
+                     primitives_.begin() + mid,
+                     primitives_.begin() + _end,
+                     [&](unsigned int a, unsigned int b) {
+                         // break ties by index to get a reproducible tree
+                         if (_data.centroids[a][_axis] != _data.centroids[b][_axis])
+                             return _data.centroids[a][_axis] < _data.centroids[b][_axis];
+                         return a < b;
+                     });
+    return mid;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool BVH::split_binned(unsigned int _begin, unsigned int _end,
+                       const vec3& _c_min, const vec3& _c_max, double _area,
+                       double _leaf_cost, const BuildData& _data, unsigned int& _mid)
+{
+    struct Bin
+    {
+        vec3 bb_min = vec3(std::numeric_limits<Scalar>::max());
+        vec3 bb_max = vec3(std::numeric_limits<Scalar>::lowest());
+        unsigned int count = 0;
+    };
+
+    double best_cost = _leaf_cost;
+    int    best_axis = -1;
+    int    best_bin  = 0;
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double extent = _c_max[axis] - _c_min[axis];
+        if (extent <= 0) continue;
+        const double scale = NUM_BINS / extent;
+
+        // sort the primitives into bins by their centers
+        Bin bins[NUM_BINS];
+        for (unsigned int i = _begin; i < _end; ++i)
+        {
+            const unsigned int p = primitives_[i];
+            const int b = std::min(NUM_BINS - 1, int((_data.centroids[p][axis] - _c_min[axis]) * scale));
+            bins[b].bb_min = min(bins[b].bb_min, _data.bb_min[p]);
+            bins[b].bb_max = max(bins[b].bb_max, _data.bb_max[p]);
+            ++bins[b].count;
+        }
+
+        // area and count of everything right of the split planes
+        double       right_area[NUM_BINS];
+        unsigned int right_count[NUM_BINS];
+        Bin right;
+        for (int b = NUM_BINS - 1; b > 0; --b)
+        {
+            right.bb_min = min(right.bb_min, bins[b].bb_min);
+            right.bb_max = max(right.bb_max, bins[b].bb_max);
+            right.count += bins[b].count;
+            right_area[b]  = half_area(right.bb_min, right.bb_max);
+            right_count[b] = right.count;
+        }
+
+        // sweep the split plane from left to right
+        Bin left;
+        for (int b = 1; b < NUM_BINS; ++b)
+        {
+            left.bb_min = min(left.bb_min, bins[b - 1].bb_min);
+            left.bb_max = max(left.bb_max, bins[b - 1].bb_max);
+            left.count += bins[b - 1].count;
+            if (!left.count || !right_count[b]) continue;
+
+            const double cost = TRAVERSAL_COST +
+                (half_area(left.bb_min, left.bb_max) * left.count +
+                 right_area[b] * right_count[b]) / _area;
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin  = b;
+            }
+        }
+    }
+
+    if (best_axis < 0) return false;
+
+    const double scale = NUM_BINS / (_c_max[best_axis] - _c_min[best_axis]);
+    auto it = std::partition(primitives_.begin() + _begin,
+                             primitives_.begin() + _end,
+                             [&](unsigned int p) {
+                                 const int b = std::min(NUM_BINS - 1,
+                                     int((_data.centroids[p][best_axis] - _c_min[best_axis]) * scale));
+                                 return b < best_bin;
+                             });
+    _mid = static_cast<unsigned int>(it - primitives_.begin());
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool BVH::split_sweep(unsigned int _begin, unsigned int _end,
+                      double _area, double _leaf_cost,
+                      const BuildData& _data, unsigned int& _mid)
+{
+    const unsigned int n = _end - _begin;
+
+    double best_cost = _leaf_cost;
+    unsigned int best_split = 0;
+    std::vector<unsigned int> best_order;
+
+    std::vector<unsigned int> order(primitives_.begin() + _begin, primitives_.begin() + _end);
+    std::vector<double> right_area(n);
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        // sort by center, break ties by index to get a reproducible tree
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            if (_data.centroids[a][axis] != _data.centroids[b][axis])
+                return _data.centroids[a][axis] < _data.centroids[b][axis];
+            return a < b;
+        });
+
+        // area of the primitives order[i..n)
+        vec3 bb_min(std::numeric_limits<Scalar>::max());
+        vec3 bb_max(std::numeric_limits<Scalar>::lowest());
+        for (unsigned int i = n - 1; i > 0; --i)
+        {
+            bb_min = min(bb_min, _data.bb_min[order[i]]);
+            bb_max = max(bb_max, _data.bb_max[order[i]]);
+            right_area[i] = half_area(bb_min, bb_max);
+        }
+
+        // split between order[i-1] and order[i]
+        bb_min = vec3(std::numeric_limits<Scalar>::max());
+        bb_max = vec3(std::numeric_limits<Scalar>::lowest());
+        bool improved = false;
+        for (unsigned int i = 1; i < n; ++i)
+        {
+            bb_min = min(bb_min, _data.bb_min[order[i - 1]]);
+            bb_max = max(bb_max, _data.bb_max[order[i - 1]]);
+
+            const double cost = TRAVERSAL_COST +
+                (half_area(bb_min, bb_max) * i + right_area[i] * (n - i)) / _area;
+            if (cost < best_cost)
+            {
+                best_cost  = cost;
+                best_split = i;
+                improved   = true;
+            }
+        }
+        if (improved) best_order = order;
+    }
+
+    if (best_order.empty()) return false;
+
+    std::copy(best_order.begin(), best_order.end(), primitives_.begin() + _begin);
+    _mid = _begin + best_split;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+double BVH::expected_cost(const std::vector<double>& _primitive_cost) const
+{
+    if (nodes_.empty()) return 0.0;
+
+    // probability of hitting a node, given the root is hit, is the ratio of
+    // their surface areas
+    const double root_area = half_area(nodes_[0].bb_min, nodes_[0].bb_max);
+
+    double cost = 0.0;
+    for (const Node& node : nodes_)
+    {
+        const double p = root_area > 0 ? half_area(node.bb_min, node.bb_max) / root_area : 1.0;
+        if (node.count)
+        {
+            double leaf_cost = 0.0;
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+                leaf_cost += _primitive_cost.empty() ? 1.0 : _primitive_cost[primitives_[i]];
+            cost += p * leaf_cost;
+        }
+        else
+        {
+            cost += p * TRAVERSAL_COST;
+        }
+    }
+
+    return cost;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::write(std::ostream& _os) const
+{
+    write_array(_os, nodes_);
+    write_array(_os, primitives_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool BVH::read(const char*& _p, const char* _end)
+{
+    bool valid = read_array(_p, _end, nodes_) && read_array(_p, _end, primitives_);
+
+    // Every leaf range and child index has to lie inside the arrays, the
+    // children have to follow their parent, and no node may be deeper than
+    // MAX_DEPTH (the root has depth 1), which keeps the traversal and its
+    // stacks in bounds. As children follow their parent, the depths can be
+    // propagated in a single pass.
+    const size_t num_nodes = nodes_.size(), num_primitives = primitives_.size();
+    std::vector<unsigned int> depth(num_nodes, 1);
+    for (size_t i = 0; valid && i < num_nodes; ++i)
+    {
+        const Node& n = nodes_[i];
+        if (n.count)
+        {
+            valid = n.count <= MAX_LEAF_SIZE && n.first <= num_primitives &&
+                    n.count <= num_primitives - n.first;
+        }
+        else
+        {
+            valid = i + 1 < n.first && n.first < num_nodes && depth[i] < MAX_DEPTH;
+            if (valid)
+            {
+                depth[i + 1]   = std::max(depth[i + 1],   depth[i] + 1);
+                depth[n.first] = std::max(depth[n.first], depth[i] + 1);
+            }
+        }
+    }
+
+    if (!valid)
+    {
+        nodes_.clear();
+        primitives_.clear();
+    }
+    return valid;
+}
+
+
+//=============================================================================
@@ -0,0 +1,575 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef BVH_H
+#define BVH_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Statistics.h"
+#include "vec3.h"
+
+#include <vector>
+#include <limits>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class BVH BVH.h
+/// This class implements a bounding volume hierarchy over a set of primitives
+/// that are only known through their axis-aligned bounding boxes. The
+/// hierarchy does not store the primitives themselves: it refers to them by
+/// their index, and the caller provides the actual ray-primitive intersection
+/// as a callback to BVH::intersect(). Callers that intersect several
+/// primitives at once use BVH::intersect_leaves() instead, which hands over
+/// whole leaves as ranges of the leaf order BVH::primitive().
+class BVH
+{
+public:
+
+    /// This type is used to choose how nodes are split during the build:
+    /// at the median along the longest axis (fast build), at the best of a
+    /// few candidate planes according to the surface area heuristic (SAH), or
+    /// at the best SAH split among all primitive positions (slow build).
+    enum Quality {MEDIAN, BINNED_SAH, SWEEP_SAH};
+
+    /// Build the hierarchy over the primitives whose bounding boxes are
+    /// given by \c _bb_min and \c _bb_max (both of the same size).
+    /// With OpenMP, large subtrees are built in parallel tasks (inside the
+    /// enclosing parallel region, if any). The resulting hierarchy does not
+    /// depend on the number of threads.
+    void build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max,
+               Quality _quality = BINNED_SAH);
+
+    /// Is the hierarchy empty?
+    bool empty() const { return nodes_.empty(); }
+
+    /// Number of nodes in the hierarchy
+    size_t num_nodes() const { return nodes_.size(); }
+
+    /// Number of primitives in the hierarchy
+    size_t num_primitives() const { return primitives_.size(); }
+
+    /// Index of the primitive at position \c _k of the leaf order, in which
+    /// the primitives of each leaf are contiguous
+    unsigned int primitive(unsigned int _k) const { return primitives_[_k]; }
+
+    /// Call \c _leaf(first, count) for each leaf, in depth-first order, with
+    /// the range [first, first + count) of the leaf order it refers to.
+    template <class Leaf>
+    void for_each_leaf(Leaf&& _leaf) const
+    {
+        for (const Node& n : nodes_)
+            if (n.count) _leaf(n.first, n.count);
+    }
+
+    /// maximum number of primitives in a leaf
+    static constexpr unsigned int MAX_LEAF_SIZE = 4;
+
+    /// Write the hierarchy to the binary stream \c _os, see read()
+    void write(std::ostream& _os) const;
+
+    /// Read a hierarchy written by write() from the memory [_p, _end), e.g.
+    /// a MappedFile, and advance \c _p behind it. Return false, and leave the
+    /// hierarchy empty, if the data is truncated or its nodes are inconsistent.
+    bool read(const char*& _p, const char* _end);
+
+    /// Expected cost of intersecting a random ray hitting the root box
+    /// according to the surface area heuristic, in units of one primitive
+    /// intersection. \c _primitive_cost optionally gives the cost of each
+    /// primitive (default: 1).
+    double expected_cost(const std::vector<double>& _primitive_cost = {}) const;
+
+    /// Intersect the hierarchy with \c _ray. Nodes are visited front-to-back
+    /// and skipped if they lie behind the closest intersection found so far.
+    /// \param[in] _ray the ray to intersect the hierarchy with
+    /// \param[in,out] _t closest ray parameter found so far (the search is
+    /// restricted to [0, _t])
+    /// \param[in] _intersect_primitive callback <tt>bool(unsigned int i, Scalar& t)</tt>
+    /// that intersects primitive \c i with the ray. It has to return true and
+    /// update \c t only if it accepts the hit, which it may only do if the
+    /// primitive is hit at most at \c t.
+    /// \return whether any primitive was hit
+    template <class IntersectPrimitive>
+    bool intersect(const Ray& _ray, Scalar& _t, IntersectPrimitive&& _intersect_primitive) const;
+
+    /// Like intersect(), but the callback
+    /// <tt>bool(unsigned int first, unsigned int count, Scalar& t)</tt>
+    /// intersects all primitives of a leaf at once: those at positions
+    /// [first, first + count) of the leaf order, see primitive().
+    template <class IntersectLeaf>
+    bool intersect_leaves(const Ray& _ray, Scalar& _t, IntersectLeaf&& _intersect_leaf) const;
+
+    /// Intersect the hierarchy with the rays of \c _packet at once. A node is
+    /// visited if any of the rays hits it, and the box tests are done for all
+    /// lanes together. Per lane, the result is the same as that of
+    /// intersect() for the single ray.
+    /// \param[in] _packet the rays to intersect the hierarchy with
+    /// \param[in] _lanes which rays of the packet to consider
+    /// \param[in,out] _t closest ray parameter found so far per lane
+    /// \param[in] _intersect_primitive callback
+    /// <tt>void(unsigned int i, const bool* lanes, Scalar* t)</tt> that
+    /// intersects primitive \c i with the rays of the packet for which
+    /// \c lanes is true, following the rules of intersect() for each lane.
+    template <class IntersectPrimitive>
+    void intersect(const RayPacket& _packet, const bool (&_lanes)[RayPacket::SIZE],
+                   Scalar (&_t)[RayPacket::SIZE],
+                   IntersectPrimitive&& _intersect_primitive) const;
+
+    /// Packet version of intersect_leaves(), with the callback
+    /// <tt>void(unsigned int first, unsigned int count, const bool* lanes, Scalar* t)</tt>.
+    template <class IntersectLeaf>
+    void intersect_leaves(const RayPacket& _packet, const bool (&_lanes)[RayPacket::SIZE],
+                          Scalar (&_t)[RayPacket::SIZE],
+                          IntersectLeaf&& _intersect_leaf) const;
+
+    /// Is any primitive hit by \c _ray before \c _tmax? Stops at the first
+    /// primitive for which \c _occluded_primitive returns true.
+    /// \param[in] _ray the ray to intersect the hierarchy with
+    /// \param[in] _tmax end of the ray segment
+    /// \param[in] _occluded_primitive callback <tt>bool(unsigned int i)</tt>
+    /// that tests whether primitive \c i is hit before \c _tmax
+    template <class OccludedPrimitive>
+    bool occluded(const Ray& _ray, Scalar _tmax, OccludedPrimitive&& _occluded_primitive) const;
+
+    /// Like occluded(), but the callback <tt>bool(unsigned int first, unsigned int count)</tt>
+    /// tests all primitives of a leaf at once, see intersect_leaves().
+    template <class OccludedLeaf>
+    bool occluded_leaves(const Ray& _ray, Scalar _tmax, OccludedLeaf&& _occluded_leaf) const;
+
+private:
+
+    /// a node of the hierarchy, stored in depth-first order
+    struct Node
+    {
+        /// minimum point of the node's bounding box
+        vec3 bb_min;
+        /// maximum point of the node's bounding box
+        vec3 bb_max;
+        /// leaf: index of the first primitive in BVH::primitives_,
+        /// inner node: index of the second child (the first child directly
+        /// follows its parent)
+        unsigned int first;
+        /// number of primitives in a leaf, 0 for inner nodes
+        unsigned int count;
+    };
+
+    /// input of the build, defined in BVH.cpp
+    struct BuildData;
+
+    /// Recursively build the subtree for primitives_[_begin, _end) and append
+    /// its nodes to \c _nodes. Child indices of inner nodes are relative to
+    /// the beginning of \c _nodes.
+    void build_recursive(unsigned int _begin, unsigned int _end,
+                         unsigned int _depth, const BuildData& _data,
+                         std::vector<Node>& _nodes);
+
+    /// Find the best split of primitives_[_begin, _end) according to the SAH.
+    /// Return false if no split is better than a leaf with \c _leaf_cost, or
+    /// reorder the primitives and store the split position in \c _mid.
+    bool split_binned(unsigned int _begin, unsigned int _end,
+                      const vec3& _c_min, const vec3& _c_max, double _area,
+                      double _leaf_cost, const BuildData& _data, unsigned int& _mid);
+    bool split_sweep(unsigned int _begin, unsigned int _end,
+                     double _area, double _leaf_cost,
+                     const BuildData& _data, unsigned int& _mid);
+
+    /// Split primitives_[_begin, _end) into halves along \c _axis.
+    unsigned int split_median(unsigned int _begin, unsigned int _end,
+                              int _axis, const BuildData& _data);
+
+    /// Intersect the rays of \c _packet selected by \c _lanes with the
+    /// bounding box of \c _node, like intersect_node() for each lane. Store
+    /// the entry parameter of the lanes that hit in \c _tentry, and infinity
+    /// for all others. Return whether any lane hits.
+    static bool intersect_node(const Node& _node, const RayPacket& _packet,
+                               const bool (&_lanes)[RayPacket::SIZE],
+                               const Scalar (&_tmax)[RayPacket::SIZE],
+                               Scalar (&_tentry)[RayPacket::SIZE]);
+
+    /// Intersect \c _ray (given by origin and inverse direction) with the
+    /// bounding box of \c _node. Return whether the ray enters the box before
+    /// \c _tmax, and store the entry parameter in \c _tentry.
+    static bool intersect_node(const Node& _node, const vec3& _origin, const vec3& _inv_dir,
+                               Scalar _tmax, Scalar& _tentry);
+
+private:
+
+    /// number of candidate split planes per axis for BINNED_SAH
+    static constexpr int NUM_BINS = 16;
+
+    /// subtrees with more primitives are built in a separate task
+    static constexpr unsigned int PARALLEL_BUILD_SIZE = 1024;
+
+    /// SAH cost of traversing an inner node, relative to intersecting a primitive
+    static constexpr double TRAVERSAL_COST = 1.0;
+
+    /// factor by which the ray interval is widened in box tests, well above
+    /// the rounding error of the Scalar type
+    static constexpr Scalar ROUNDING_SLACK = sizeof(Scalar) < sizeof(double)
+                                             ? Scalar(1.0 + 1e-5) : Scalar(1.0 + 1e-9);
+
+    /// maximum depth of the traversal stack
+    static constexpr unsigned int MAX_DEPTH = 64;
+
+    /// array of nodes, the root is nodes_[0]
+    std::vector<Node> nodes_;
+
+    /// primitive indices, referenced by the leaves
+    std::vector<unsigned int> primitives_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// read BVH build quality ("median", "binned", or "sweep") from stream
+inline std::istream& operator>>(std::istream& is, BVH::Quality& q)
+{
+    std::string name;
+    is >> name;
+    if      (name == "median") q = BVH::MEDIAN;
+    else if (name == "binned") q = BVH::BINNED_SAH;
+    else if (name == "sweep")  q = BVH::SWEEP_SAH;
+    else throw std::runtime_error("Invalid BVH quality " + name);
+    return is;
+}
+
+/// output BVH build quality
+inline std::ostream& operator<<(std::ostream& os, BVH::Quality q)
+{
+    switch (q)
+    {
+        case BVH::MEDIAN:     os << "median";     break;
+        case BVH::BINNED_SAH: os << "binned SAH"; break;
+        case BVH::SWEEP_SAH:  os << "sweep SAH";  break;
+    }
+    return os;
+}
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+inline bool BVH::intersect_node(const Node& _node, const vec3& _origin, const vec3& _inv_dir,
+                                Scalar _tmax, Scalar& _tentry)
+{
+    Statistics::count(Statistics::BOX_TESTS);
+
+    Scalar tmin = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+        Scalar t0 = (_node.bb_min[i] - _origin[i]) * _inv_dir[i];
+        Scalar t1 = (_node.bb_max[i] - _origin[i]) * _inv_dir[i];
+        if (t0 > t1) std::swap(t0, t1);
+
+        // written such that NaNs (0 * inf) do not cut the interval
+        tmin = t0 > tmin ? t0 : tmin;
+        _tmax = t1 < _tmax ? t1 : _tmax;
+    }
+
+    // The slab intersections are computed differently than the primitive
+    // intersections, so allow for rounding: otherwise a primitive hit exactly
+    // at _tmax (e.g. the other face at an edge) might be missed.
+    _tentry = tmin;
+    return tmin <= _tmax * ROUNDING_SLACK;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class IntersectPrimitive>
+bool BVH::intersect(const Ray& _ray, Scalar& _t, IntersectPrimitive&& _intersect_primitive) const
+{
+    return intersect_leaves(_ray, _t, [&](unsigned int _first, unsigned int _count, Scalar& t) {
+        bool hit = false;
+        for (unsigned int i = _first; i < _first + _count; ++i)
+        {
+            if (_intersect_primitive(primitives_[i], t))
+                hit = true;
+        }
+        return hit;
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class IntersectLeaf>
+bool BVH::intersect_leaves(const Ray& _ray, Scalar& _t, IntersectLeaf&& _intersect_leaf) const
+{
+    if (nodes_.empty()) return false;
+
+    const vec3 inv_dir(Scalar(1) / _ray.direction[0],
+                       Scalar(1) / _ray.direction[1],
+                       Scalar(1) / _ray.direction[2]);
+
+    Scalar tentry, tleft, tright;
+    if (!intersect_node(nodes_[0], _ray.origin, inv_dir, _t, tentry))
+        return false;
+
+    // stack of nodes still to be visited, together with their entry parameter
+    unsigned int stack[MAX_DEPTH];
+    Scalar       stack_t[MAX_DEPTH];
+    unsigned int stack_size = 0;
+
+    bool hit = false;
+    unsigned int node = 0;
+
+    for (;;)
+    {
+        const Node& n = nodes_[node];
+
+        if (n.count)
+        {
+            // leaf: intersect all of its primitives
+            if (_intersect_leaf(n.first, n.count, _t))
+                hit = true;
+        }
+        else
+        {
+            // inner node: descend into the closer child, remember the other one
+            unsigned int left  = node + 1;
+            unsigned int right = n.first;
+            bool hit_left  = intersect_node(nodes_[left],  _ray.origin, inv_dir, _t, tleft);
+            bool hit_right = intersect_node(nodes_[right], _ray.origin, inv_dir, _t, tright);
+
+            if (hit_left && hit_right)
+            {
+                if (tright < tleft)
+                {
+                    std::swap(left, right);
+                    std::swap(tleft, tright);
+                }
+                stack[stack_size]   = right;
+                stack_t[stack_size] = tright;
+                ++stack_size;
+                node = left;
+                continue;
+            }
+            if (hit_left)  { node = left;  continue; }
+            if (hit_right) { node = right; continue; }
+        }
+
+        // pop the next node that is not behind the closest intersection
+        for (;;)
+        {
+            if (!stack_size) return hit;
+            --stack_size;
+            if (stack_t[stack_size] <= _t * ROUNDING_SLACK) break;
+        }
+        node = stack[stack_size];
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+inline bool BVH::intersect_node(const Node& _node, const RayPacket& _packet,
+                                const bool (&_lanes)[RayPacket::SIZE],
+                                const Scalar (&_tmax)[RayPacket::SIZE],
+                                Scalar (&_tentry)[RayPacket::SIZE])
+{
+    Scalar tmin[RayPacket::SIZE], tmax[RayPacket::SIZE];
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        tmin[l] = 0.0;
+        tmax[l] = _tmax[l];
+    }
+
+    // same arithmetic as for a single ray, one axis for all lanes at a time
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int l = 0; l < RayPacket::SIZE; ++l)
+        {
+            Scalar t0 = (_node.bb_min[i] - _packet.origin[i][l]) * _packet.inv_direction[i][l];
+            Scalar t1 = (_node.bb_max[i] - _packet.origin[i][l]) * _packet.inv_direction[i][l];
+            const Scalar lo = t0 > t1 ? t1 : t0;
+            const Scalar hi = t0 > t1 ? t0 : t1;
+            tmin[l] = lo > tmin[l] ? lo : tmin[l];
+            tmax[l] = hi < tmax[l] ? hi : tmax[l];
+        }
+    }
+
+    bool any = false;
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        Statistics::count(Statistics::BOX_TESTS, _lanes[l]);
+        const bool hit = _lanes[l] && tmin[l] <= tmax[l] * ROUNDING_SLACK;
+        _tentry[l] = hit ? tmin[l] : std::numeric_limits<Scalar>::infinity();
+        any |= hit;
+    }
+    return any;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class IntersectPrimitive>
+void BVH::intersect(const RayPacket& _packet, const bool (&_lanes)[RayPacket::SIZE],
+                    Scalar (&_t)[RayPacket::SIZE],
+                    IntersectPrimitive&& _intersect_primitive) const
+{
+    intersect_leaves(_packet, _lanes, _t,
+                     [&](unsigned int _first, unsigned int _count, const bool* lanes, Scalar* t) {
+        for (unsigned int i = _first; i < _first + _count; ++i)
+            _intersect_primitive(primitives_[i], lanes, t);
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class IntersectLeaf>
+void BVH::intersect_leaves(const RayPacket& _packet, const bool (&_lanes)[RayPacket::SIZE],
+                           Scalar (&_t)[RayPacket::SIZE],
+                           IntersectLeaf&& _intersect_leaf) const
+{
+    if (nodes_.empty()) return;
+
+    // stack of nodes still to be visited, with the lanes' entry parameters
+    struct Entry
+    {
+        unsigned int node;
+        Scalar tentry[RayPacket::SIZE];
+    };
+    Entry stack[MAX_DEPTH + 1];
+    unsigned int stack_size = 0;
+
+    Entry& root = stack[stack_size];
+    root.node = 0;
+    if (!intersect_node(nodes_[0], _packet, _lanes, _t, root.tentry)) return;
+    ++stack_size;
+
+    Entry left, right;
+    bool lanes[RayPacket::SIZE];
+
+    while (stack_size)
+    {
+        const Entry& entry = stack[--stack_size];
+
+        // lanes that still have to visit the node. Lanes that missed it have
+        // to be excluded explicitly: as long as a lane has not hit anything,
+        // its slack bound _t * ROUNDING_SLACK overflows to infinity, too.
+        bool any = false;
+        for (int l = 0; l < RayPacket::SIZE; ++l)
+        {
+            lanes[l] = entry.tentry[l] != std::numeric_limits<Scalar>::infinity() &&
+                       entry.tentry[l] <= _t[l] * ROUNDING_SLACK;
+            any |= lanes[l];
+        }
+        if (!any) continue;
+
+        const Node& n = nodes_[entry.node];
+
+        if (n.count)
+        {
+            _intersect_leaf(n.first, n.count, lanes, _t);
+        }
+        else
+        {
+            left.node  = entry.node + 1;
+            right.node = n.first;
+            const bool hit_left  = intersect_node(nodes_[left.node],  _packet, lanes, _t, left.tentry);
+            const bool hit_right = intersect_node(nodes_[right.node], _packet, lanes, _t, right.tentry);
+
+            // visit the child first that is closer for most of the lanes
+            int votes = 0;
+            for (int l = 0; l < RayPacket::SIZE; ++l)
+            {
+                if (left.tentry[l] < right.tentry[l]) ++votes;
+                else if (right.tentry[l] < left.tentry[l]) --votes;
+            }
+            const bool left_first = votes >= 0;
+
+            if (hit_left && hit_right)
+            {
+                stack[stack_size++] = left_first ? right : left;
+                stack[stack_size++] = left_first ? left : right;
+            }
+            else if (hit_left)  stack[stack_size++] = left;
+            else if (hit_right) stack[stack_size++] = right;
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class OccludedPrimitive>
+bool BVH::occluded(const Ray& _ray, Scalar _tmax, OccludedPrimitive&& _occluded_primitive) const
+{
+    return occluded_leaves(_ray, _tmax, [&](unsigned int _first, unsigned int _count) {
+        for (unsigned int i = _first; i < _first + _count; ++i)
+        {
+            if (_occluded_primitive(primitives_[i]))
+                return true;
+        }
+        return false;
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class OccludedLeaf>
+bool BVH::occluded_leaves(const Ray& _ray, Scalar _tmax, OccludedLeaf&& _occluded_leaf) const
+{
+    if (nodes_.empty()) return false;
+
+    const vec3 inv_dir(Scalar(1) / _ray.direction[0],
+                       Scalar(1) / _ray.direction[1],
+                       Scalar(1) / _ray.direction[2]);
+
+    // any hit will do, so the order of traversal does not matter
+    unsigned int stack[MAX_DEPTH + 1];
+    unsigned int stack_size = 0;
+    Scalar tentry;
+
+    stack[stack_size++] = 0;
+    while (stack_size)
+    {
+        const Node& n = nodes_[stack[--stack_size]];
+        if (!intersect_node(n, _ray.origin, inv_dir, _tmax, tentry))
+            continue;
+
+        if (n.count)
+        {
+            if (_occluded_leaf(n.first, n.count))
+                return true;
+        }
+        else
+        {
+            stack[stack_size++] = n.first;
+            stack[stack_size++] = static_cast<unsigned int>(&n - nodes_.data()) + 1;
+        }
+    }
+
+    return false;
+}
+
+
+//=============================================================================
+#endif // BVH_H defined
+//=============================================================================
@@ -15,6 +15,7 @@
 //== INCLUDES =================================================================
 
 #include "vec3.h"
+#include "RayPacket.h"
 
 
 //== CLASS DEFINITION =========================================================
@@ -81,7 +82,27 @@ public:
     /// \param[in] _y pixel location in image
     Ray primary_ray(unsigned int _x, unsigned int _y) const
     {
-        return Ray(eye, lower_left + static_cast<double>(_x)*x_dir + static_cast<double>(_y)*y_dir - eye);
+        return Ray(eye, lower_left + static_cast<Scalar>(_x)*x_dir + static_cast<Scalar>(_y)*y_dir - eye);
+    }
+
+
+    /// create the rays of a packet for the block of pixels starting at
+    /// (\c _x, \c _y). Lanes of pixels at or beyond (\c _x_end, \c _y_end) stay
+    /// inactive.
+    /// \param[in] _x,_y lower left pixel of the block
+    /// \param[in] _x_end,_y_end end of the pixel range to create rays for
+    /// \param[out] _packet the packet to fill
+    void primary_rays(unsigned int _x, unsigned int _y,
+                      unsigned int _x_end, unsigned int _y_end,
+                      RayPacket& _packet) const
+    {
+        for (int l = 0; l < RayPacket::SIZE; ++l)
+        {
+            const unsigned int x = _x + l % RayPacket::WIDTH;
+            const unsigned int y = _y + l / RayPacket::WIDTH;
+            if (x < _x_end && y < _y_end)
+                _packet.set(l, primary_ray(x, y));
+        }
     }
 
 
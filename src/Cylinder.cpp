@@ -23,18 +23,18 @@ Cylinder::
 intersect(const Ray& _ray,
           vec3& _intersection_point,
           vec3& _intersection_normal,
-          double& _intersection_t) const
+          Scalar& _intersection_t) const
 {
     vec3 oc = _ray.origin - center;
     vec3 d = _ray.direction;
     vec3 a = axis;
 
-    double A = dot(d - dot(d, a) * a, d - dot(d, a) * a);
-    double B = 2.0 * dot(d - dot(d, a) * a, oc - dot(oc, a) * a);
-    double C = dot(oc - dot(oc, a) * a, oc - dot(oc, a) * a) - radius * radius;
+    Scalar A = dot(d - dot(d, a) * a, d - dot(d, a) * a);
+    Scalar B = 2.0 * dot(d - dot(d, a) * a, oc - dot(oc, a) * a);
+    Scalar C = dot(oc - dot(oc, a) * a, oc - dot(oc, a) * a) - radius * radius;
 
 
-    std::array<double, 2> t;
+    std::array<Scalar, 2> t;
     size_t nsol = solveQuadratic(A, B, C, t);
 
     _intersection_t = NO_INTERSECTION;
@@ -44,7 +44,7 @@ intersect(const Ray& _ray,
         if (t[i] > 0) {
             vec3 intersection_point_temp = _ray.origin + t[i] * _ray.direction;
             vec3 v = intersection_point_temp - center;
-            double height_projection = dot(v, a);
+            Scalar height_projection = dot(v, a);
             if (height_projection >= 0 && height_projection <= height) {
                 _intersection_t = std::min(_intersection_t, t[i]);
                 _intersection_point = intersection_point_temp;
@@ -66,3 +66,52 @@ intersect(const Ray& _ray,
 
     return true;
 }
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Cylinder::
+occluded(const Ray& _ray, Scalar _tmax) const
+{
+    vec3 oc = _ray.origin - center;
+    vec3 d = _ray.direction;
+    vec3 a = axis;
+
+    Scalar A = dot(d - dot(d, a) * a, d - dot(d, a) * a);
+    Scalar B = 2.0 * dot(d - dot(d, a) * a, oc - dot(oc, a) * a);
+    Scalar C = dot(oc - dot(oc, a) * a, oc - dot(oc, a) * a) - radius * radius;
+
+    std::array<Scalar, 2> t;
+    size_t nsol = solveQuadratic(A, B, C, t);
+
+    // any solution in range that lies between the cylinder's ends
+    for (size_t i = 0; i < nsol; ++i) {
+        if (t[i] > 0 && t[i] < _tmax) {
+            Scalar height_projection = dot(oc + t[i] * d, a);
+            if (height_projection >= 0 && height_projection <= height) return true;
+        }
+    }
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Cylinder::
+bounds(vec3& _bb_min, vec3& _bb_max) const
+{
+    // The cylinder extends from its base center along the axis by height.
+    // Its rims are circles perpendicular to the axis, whose extent along
+    // coordinate axis i is radius * sqrt(1 - axis[i]^2).
+    const vec3 top = center + height * axis;
+    const vec3 rim(radius * sqrt(std::max(Scalar(0), Scalar(1) - axis[0] * axis[0])),
+                   radius * sqrt(std::max(Scalar(0), Scalar(1) - axis[1] * axis[1])),
+                   radius * sqrt(std::max(Scalar(0), Scalar(1) - axis[2] * axis[2])));
+    _bb_min = min(center, top) - rim;
+    _bb_max = max(center, top) + rim;
+    return true;
+}
@@ -25,14 +25,14 @@
 /// This class implements a cylinder object, which is specified by its center,
 //  unit axis vector, radius, and height.
 /// This class overrides the intersection method Object::intersect().
-class Cylinder : public Object
+class Cylinder final : public Object
 {
 public:
     /// Construct a cylinder by directly specifying its parameters
     Cylinder(const vec3 &_center = vec3(0,0,0),
-             double _radius = 1,
+             Scalar _radius = 1,
              const vec3 &_axis = vec3(1,0,0),
-             double _height = 1)
+             Scalar _height = 1)
         :  center(_center), radius(_radius), axis(_axis), height(_height) { }
 
     /// Construct a cylinder with parameters parsed from an input stream.
@@ -48,7 +48,14 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const override;
+                           Scalar&     _intersection_t) const override;
+
+    /// Is there an intersection of the cylinder with \c _ray before \c _tmax?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray, Scalar _tmax) const override;
+
+    /// Bounding box of the cylinder. This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override;
 
     /// parse cylinder from an input stream
     virtual void parse(std::istream &is) override {
@@ -64,10 +71,10 @@ private:
     vec3 axis;
 
     /// radius
-    double radius;
+    Scalar radius;
 
     /// height
-    double height;
+    Scalar height;
 };
 
 //=============================================================================
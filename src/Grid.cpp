@@ -0,0 +1,116 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Grid.h"
+#include "Profiler.h"
+
+#include <cassert>
+#include <cmath>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+void Grid::build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max)
+{
+    Profiler::Scope scope("grid");
+    assert(_bb_min.size() == _bb_max.size());
+
+    cell_start_.clear();
+    primitives_.clear();
+    if (_bb_min.empty()) return;
+
+    // Primitives with an empty box, e.g. meshes that could not be loaded,
+    // are left out of the grid: they cannot be hit, and the cells of their
+    // inverted boxes would be out of any range.
+    auto is_empty = [&](size_t _i) {
+        return _bb_min[_i][0] > _bb_max[_i][0] || _bb_min[_i][1] > _bb_max[_i][1] ||
+               _bb_min[_i][2] > _bb_max[_i][2];
+    };
+
+    // bounding box of all primitives
+    bb_min_ = vec3(std::numeric_limits<Scalar>::max());
+    bb_max_ = vec3(std::numeric_limits<Scalar>::lowest());
+    for (size_t i = 0; i < _bb_min.size(); ++i)
+    {
+        if (is_empty(i)) continue;
+        bb_min_ = min(bb_min_, _bb_min[i]);
+        bb_max_ = max(bb_max_, _bb_max[i]);
+    }
+    if (bb_min_[0] > bb_max_[0]) return;
+
+    // Choose cubic cells such that there are CELLS_PER_PRIMITIVE cells per
+    // primitive. Flat extents are widened a bit, so that they get one cell.
+    vec3 extent = bb_max_ - bb_min_;
+    const Scalar max_extent = std::max(extent[0], std::max(extent[1], extent[2]));
+    for (int i = 0; i < 3; ++i)
+        extent[i] = std::max(extent[i], Scalar(1e-3) * max_extent);
+    const double volume = double(extent[0]) * extent[1] * extent[2];
+    const double cells_per_length = volume > 0 ? std::cbrt(CELLS_PER_PRIMITIVE * _bb_min.size() / volume) : 0.0;
+
+    size_t num_cells = 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        resolution_[i] = std::min(std::max(int(std::lround(extent[i] * cells_per_length)), 1), MAX_RESOLUTION);
+        num_cells *= resolution_[i];
+
+        cell_size_[i]     = (bb_max_[i] - bb_min_[i]) / resolution_[i];
+        inv_cell_size_[i] = cell_size_[i] > 0 ? Scalar(1) / cell_size_[i] : Scalar(0);
+    }
+
+    // range of cells overlapped by the box of primitive _i, widened by a
+    // fraction of a cell, such that primitives touching a cell boundary are
+    // found from both sides despite rounding. The cells are clamped before
+    // they are converted to int, which would be undefined out of its range.
+    auto cell_range = [&](size_t _i, int _lo[3], int _hi[3]) {
+        for (int a = 0; a < 3; ++a)
+        {
+            const Scalar pad  = Scalar(1e-4) * cell_size_[a];
+            const Scalar last = Scalar(resolution_[a] - 1);
+            const Scalar lo   = (_bb_min[_i][a] - pad - bb_min_[a]) * inv_cell_size_[a];
+            const Scalar hi   = (_bb_max[_i][a] + pad - bb_min_[a]) * inv_cell_size_[a];
+            _lo[a] = int(std::min(std::max(Scalar(0), lo), last));
+            _hi[a] = int(std::min(std::max(Scalar(0), hi), last));
+        }
+    };
+
+    // count the references of each cell, then store them in a single array
+    // ("compressed rows"), with the primitives of each cell in index order
+    int lo[3], hi[3];
+    cell_start_.assign(num_cells + 1, 0);
+    for (size_t i = 0; i < _bb_min.size(); ++i)
+    {
+        if (is_empty(i)) continue;
+        cell_range(i, lo, hi);
+        for (int z = lo[2]; z <= hi[2]; ++z)
+            for (int y = lo[1]; y <= hi[1]; ++y)
+                for (int x = lo[0]; x <= hi[0]; ++x)
+                    ++cell_start_[x + resolution_[0] * (y + resolution_[1] * z) + 1];
+    }
+    for (size_t c = 0; c < num_cells; ++c)
+        cell_start_[c + 1] += cell_start_[c];
+
+    primitives_.resize(cell_start_[num_cells]);
+    std::vector<unsigned int> fill(cell_start_.begin(), cell_start_.end() - 1);
+    for (size_t i = 0; i < _bb_min.size(); ++i)
+    {
+        if (is_empty(i)) continue;
+        cell_range(i, lo, hi);
+        for (int z = lo[2]; z <= hi[2]; ++z)
+            for (int y = lo[1]; y <= hi[1]; ++y)
+                for (int x = lo[0]; x <= hi[0]; ++x)
+                    primitives_[fill[x + resolution_[0] * (y + resolution_[1] * z)]++] = static_cast<unsigned int>(i);
+    }
+}
+
+
+//=============================================================================
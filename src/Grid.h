@@ -0,0 +1,289 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef GRID_H
+#define GRID_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Statistics.h"
+#include "vec3.h"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Grid Grid.h
+/// This class implements a uniform grid over a set of primitives that are
+/// only known through their axis-aligned bounding boxes, as an alternative to
+/// the BVH for many primitives of similar size. Each cell lists the
+/// primitives whose boxes overlap it, and rays walk through the cells they
+/// pierce in front-to-back order (3D-DDA). Like the BVH, the grid refers to
+/// primitives by their index, and the caller provides the ray-primitive
+/// intersection as a callback with the same signature as for the BVH.
+class Grid
+{
+public:
+
+    /// Build the grid over the primitives whose bounding boxes are given by
+    /// \c _bb_min and \c _bb_max (both of the same size). The number of cells
+    /// is proportional to the number of primitives, and the cells are as
+    /// close to cubes as possible.
+    void build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max);
+
+    /// Is the grid empty?
+    bool empty() const { return cell_start_.empty(); }
+
+    /// Number of cells along axis \c _axis
+    int resolution(int _axis) const { return resolution_[_axis]; }
+
+    /// Number of cells
+    size_t num_cells() const { return cell_start_.empty() ? 0 : cell_start_.size() - 1; }
+
+    /// Number of references from cells to primitives. Primitives that
+    /// overlap several cells are referenced by each of them.
+    size_t num_references() const { return primitives_.size(); }
+
+    /// Intersect the grid with \c _ray, with the same arguments and results as
+    /// BVH::intersect(). Cells are visited front to back until one is behind
+    /// the closest intersection found so far. A primitive may be tested
+    /// several times, once for each cell that refers to it.
+    template <class IntersectPrimitive>
+    bool intersect(const Ray& _ray, Scalar& _t, IntersectPrimitive&& _intersect_primitive) const;
+
+    /// Intersect the grid with the rays of \c _packet, with the same
+    /// arguments and results as the packet version of BVH::intersect(). The
+    /// rays walk through the grid one after the other, and the callback is
+    /// called with only one lane active.
+    template <class IntersectPrimitive>
+    void intersect(const RayPacket& _packet, const bool (&_lanes)[RayPacket::SIZE],
+                   Scalar (&_t)[RayPacket::SIZE],
+                   IntersectPrimitive&& _intersect_primitive) const;
+
+    /// Is any primitive hit by \c _ray before \c _tmax? Same as BVH::occluded().
+    template <class OccludedPrimitive>
+    bool occluded(const Ray& _ray, Scalar _tmax, OccludedPrimitive&& _occluded_primitive) const;
+
+private:
+
+    /// Call \c _visit_cell(first, last) for the range [first, last) of
+    /// primitives_ of each cell that \c _ray pierces, front to back, until it
+    /// returns true, or until the next cell starts behind \c _tmax (which the
+    /// callback may decrease). Return whether \c _visit_cell returned true.
+    template <class VisitCell>
+    bool traverse(const Ray& _ray, const Scalar& _tmax, VisitCell&& _visit_cell) const;
+
+    /// The primitives a ray tested last. A primitive that overlaps several
+    /// cells along the ray only has to be tested in the first of them.
+    struct Mailbox
+    {
+        /// Has primitive \c _i been tested? If not, remember it as tested.
+        bool tested(unsigned int _i)
+        {
+            for (unsigned int k = 0; k < SIZE; ++k)
+                if (ids[k] == _i) return true;
+            ids[next] = _i;
+            next = (next + 1) % SIZE;
+            return false;
+        }
+
+        /// number of primitives remembered
+        static constexpr unsigned int SIZE = 8;
+        /// the primitives, replaced in round robin order
+        unsigned int ids[SIZE] = {~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u};
+        /// where to remember the next primitive
+        unsigned int next = 0;
+    };
+
+private:
+
+    /// number of cells per primitive
+    static constexpr double CELLS_PER_PRIMITIVE = 8.0;
+
+    /// maximum number of cells along an axis
+    static constexpr int MAX_RESOLUTION = 128;
+
+    /// factor by which the ray interval is widened in cell tests, well above
+    /// the rounding error of the Scalar type (see BVH::ROUNDING_SLACK)
+    static constexpr Scalar ROUNDING_SLACK = sizeof(Scalar) < sizeof(double)
+                                             ? Scalar(1.0 + 1e-5) : Scalar(1.0 + 1e-9);
+
+    /// minimum and maximum point of the grid's bounding box
+    vec3 bb_min_, bb_max_;
+
+    /// size of a cell and its inverse
+    vec3 cell_size_, inv_cell_size_;
+
+    /// number of cells along each axis
+    int resolution_[3] = {0, 0, 0};
+
+    /// the primitives of cell c are primitives_[cell_start_[c], cell_start_[c+1]),
+    /// cells are ordered by x, then y, then z
+    std::vector<unsigned int> cell_start_;
+
+    /// primitive indices, referenced by the cells
+    std::vector<unsigned int> primitives_;
+};
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+template <class VisitCell>
+bool Grid::traverse(const Ray& _ray, const Scalar& _tmax, VisitCell&& _visit_cell) const
+{
+    if (cell_start_.empty()) return false;
+
+    const vec3 inv_dir(Scalar(1) / _ray.direction[0],
+                       Scalar(1) / _ray.direction[1],
+                       Scalar(1) / _ray.direction[2]);
+
+    // interval of the ray inside the grid's bounding box
+    Scalar tenter = 0.0, texit = _tmax;
+    for (int i = 0; i < 3; ++i)
+    {
+        Scalar t0 = (bb_min_[i] - _ray.origin[i]) * inv_dir[i];
+        Scalar t1 = (bb_max_[i] - _ray.origin[i]) * inv_dir[i];
+        if (t0 > t1) std::swap(t0, t1);
+        tenter = t0 > tenter ? t0 : tenter;
+        texit  = t1 < texit  ? t1 : texit;
+    }
+    if (tenter > texit * ROUNDING_SLACK) return false;
+
+    // cell of the entry point, and for each axis the direction of the steps,
+    // the index at which the ray leaves the grid, and the ray parameter at
+    // which it crosses the next cell boundary
+    int cell[3], step[3], stop[3];
+    Scalar tnext[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const Scalar p = _ray.origin[i] + tenter * _ray.direction[i];
+        cell[i] = std::min(std::max(int((p - bb_min_[i]) * inv_cell_size_[i]), 0), resolution_[i] - 1);
+
+        if (_ray.direction[i] > 0)
+        {
+            step[i]  = 1;
+            stop[i]  = resolution_[i];
+            tnext[i] = (bb_min_[i] + (cell[i] + 1) * cell_size_[i] - _ray.origin[i]) * inv_dir[i];
+        }
+        else if (_ray.direction[i] < 0)
+        {
+            step[i]  = -1;
+            stop[i]  = -1;
+            tnext[i] = (bb_min_[i] + cell[i] * cell_size_[i] - _ray.origin[i]) * inv_dir[i];
+        }
+        else
+        {
+            step[i]  = 0;
+            stop[i]  = -1;
+            tnext[i] = std::numeric_limits<Scalar>::infinity();
+        }
+    }
+
+    for (;;)
+    {
+        // Cells that start behind the closest intersection can be skipped.
+        // Allow for rounding, as for the nodes of the BVH.
+        if (tenter > _tmax * ROUNDING_SLACK) return false;
+
+        Statistics::count(Statistics::BOX_TESTS);
+        const unsigned int c = cell[0] + resolution_[0] * (cell[1] + resolution_[1] * cell[2]);
+        if (cell_start_[c] != cell_start_[c + 1] && _visit_cell(cell_start_[c], cell_start_[c + 1]))
+            return true;
+
+        // step to the neighbor across the closest cell boundary. Boundaries
+        // are computed from the cell index rather than accumulated, so that
+        // rounding errors do not add up along the ray.
+        const int i = tnext[0] < tnext[1] ? (tnext[0] < tnext[2] ? 0 : 2)
+                                          : (tnext[1] < tnext[2] ? 1 : 2);
+        tenter = tnext[i];
+        cell[i] += step[i];
+        if (cell[i] == stop[i] || step[i] == 0) return false;
+        tnext[i] = (bb_min_[i] + (cell[i] + (step[i] > 0)) * cell_size_[i] - _ray.origin[i]) * inv_dir[i];
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class IntersectPrimitive>
+bool Grid::intersect(const Ray& _ray, Scalar& _t, IntersectPrimitive&& _intersect_primitive) const
+{
+    bool hit = false;
+    Mailbox mailbox;
+    traverse(_ray, _t, [&](unsigned int _first, unsigned int _last) {
+        for (unsigned int k = _first; k < _last; ++k)
+        {
+            if (!mailbox.tested(primitives_[k]) && _intersect_primitive(primitives_[k], _t))
+                hit = true;
+        }
+        return false;
+    });
+    return hit;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class IntersectPrimitive>
+void Grid::intersect(const RayPacket& _packet, const bool (&_lanes)[RayPacket::SIZE],
+                     Scalar (&_t)[RayPacket::SIZE],
+                     IntersectPrimitive&& _intersect_primitive) const
+{
+    bool lane[RayPacket::SIZE] = {};
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        if (!_lanes[l]) continue;
+
+        lane[l] = true;
+        Mailbox mailbox;
+        traverse(_packet.rays[l], _t[l], [&](unsigned int _first, unsigned int _last) {
+            for (unsigned int k = _first; k < _last; ++k)
+            {
+                if (!mailbox.tested(primitives_[k]))
+                    _intersect_primitive(primitives_[k], lane, _t);
+            }
+            return false;
+        });
+        lane[l] = false;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class OccludedPrimitive>
+bool Grid::occluded(const Ray& _ray, Scalar _tmax, OccludedPrimitive&& _occluded_primitive) const
+{
+    Mailbox mailbox;
+    return traverse(_ray, _tmax, [&](unsigned int _first, unsigned int _last) {
+        for (unsigned int k = _first; k < _last; ++k)
+        {
+            if (!mailbox.tested(primitives_[k]) && _occluded_primitive(primitives_[k]))
+                return true;
+        }
+        return false;
+    });
+}
+
+
+//=============================================================================
+#endif // GRID_H defined
+//=============================================================================
@@ -15,6 +15,7 @@
 
 #include "vec3.h"
 #include <vector>
+#include <string>
 #include <assert.h>
 #include <fstream>
 
@@ -113,6 +114,36 @@ public:
         return true;
     }
 
+    /// Reads an image in TGA format from a file, as written by write().
+    /// Only uncompressed 24 or 32 bit images are supported.
+    /// \param[in] _filename Filename to read the image from.
+    /// \return whether the file could be read
+    bool read(const std::string &_filename)
+    {
+        std::ifstream file(_filename, std::fstream::binary);
+        if (!file) return false;
+
+        unsigned char header[18];
+        if (!file.read(reinterpret_cast<char*>(header), 18)) return false;
+        const unsigned int bytes = header[16] / 8;
+        if (header[2] != 2 || (bytes != 3 && bytes != 4)) return false;
+        file.ignore(header[0]); // image id
+
+        resize(header[12] + 256 * header[13], header[14] + 256 * header[15]);
+        const bool top_down = header[17] & 0x20;
+
+        unsigned char bgra[4];
+        for (unsigned int y = 0; y < height_; ++y)
+        {
+            for (unsigned int x = 0; x < width_; ++x)
+            {
+                if (!file.read(reinterpret_cast<char*>(bgra), bytes)) return false;
+                (*this)(x, top_down ? height_ - 1 - y : y) = vec3(bgra[2], bgra[1], bgra[0]) / Scalar(255);
+            }
+        }
+        return true;
+    }
+
 
 private:
 
@@ -0,0 +1,210 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Instance.h"
+
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// Apply the affine transformation \c _m (the first three rows of a 4x4
+/// matrix) to the point \c _p
+static vec3 transform_point(const Scalar _m[3][4], const vec3& _p)
+{
+    return vec3(_m[0][0]*_p[0] + _m[0][1]*_p[1] + _m[0][2]*_p[2] + _m[0][3],
+                _m[1][0]*_p[0] + _m[1][1]*_p[1] + _m[1][2]*_p[2] + _m[1][3],
+                _m[2][0]*_p[0] + _m[2][1]*_p[1] + _m[2][2]*_p[2] + _m[2][3]);
+}
+
+
+/// Apply the linear part of the affine transformation \c _m to the vector \c _v
+static vec3 transform_vector(const Scalar _m[3][4], const vec3& _v)
+{
+    return vec3(_m[0][0]*_v[0] + _m[0][1]*_v[1] + _m[0][2]*_v[2],
+                _m[1][0]*_v[0] + _m[1][1]*_v[1] + _m[1][2]*_v[2],
+                _m[2][0]*_v[0] + _m[2][1]*_v[1] + _m[2][2]*_v[2]);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Instance::Instance(std::shared_ptr<const Mesh> _mesh, std::istream& is)
+: mesh_(std::move(_mesh))
+{
+    parse(is);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Instance::parse(std::istream& is)
+{
+    double m[4][4];
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            is >> m[i][j];
+    is >> material;
+
+    if (m[3][0] != 0 || m[3][1] != 0 || m[3][2] != 0 || m[3][3] != 1)
+        throw std::runtime_error("Instance transformation is not affine");
+
+    // inverse of the linear part by cofactors, in double precision
+    double inv[3][3];
+    inv[0][0] = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+    inv[0][1] = m[0][2]*m[2][1] - m[0][1]*m[2][2];
+    inv[0][2] = m[0][1]*m[1][2] - m[0][2]*m[1][1];
+    inv[1][0] = m[1][2]*m[2][0] - m[1][0]*m[2][2];
+    inv[1][1] = m[0][0]*m[2][2] - m[0][2]*m[2][0];
+    inv[1][2] = m[0][2]*m[1][0] - m[0][0]*m[1][2];
+    inv[2][0] = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+    inv[2][1] = m[0][1]*m[2][0] - m[0][0]*m[2][1];
+    inv[2][2] = m[0][0]*m[1][1] - m[0][1]*m[1][0];
+    const double det = m[0][0]*inv[0][0] + m[0][1]*inv[1][0] + m[0][2]*inv[2][0];
+    if (std::abs(det) < std::numeric_limits<double>::min())
+        throw std::runtime_error("Instance transformation is not invertible");
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            inv[i][j] /= det;
+            to_world_[i][j]  = static_cast<Scalar>(m[i][j]);
+            to_object_[i][j] = static_cast<Scalar>(inv[i][j]);
+        }
+        to_world_[i][3] = static_cast<Scalar>(m[i][3]);
+    }
+
+    // the inverse translation undoes the translation after the linear part
+    for (int i = 0; i < 3; ++i)
+        to_object_[i][3] = static_cast<Scalar>(-(inv[i][0]*m[0][3] + inv[i][1]*m[1][3] + inv[i][2]*m[2][3]));
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Ray Instance::to_object(const Ray& _ray) const
+{
+    Ray ray;
+    ray.origin    = transform_point(to_object_, _ray.origin);
+    ray.direction = transform_vector(to_object_, _ray.direction);
+    return ray;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+vec3 Instance::normal_to_world(const vec3& _normal) const
+{
+    // normals transform with the transpose of the inverse
+    return normalize(vec3(to_object_[0][0]*_normal[0] + to_object_[1][0]*_normal[1] + to_object_[2][0]*_normal[2],
+                          to_object_[0][1]*_normal[0] + to_object_[1][1]*_normal[1] + to_object_[2][1]*_normal[2],
+                          to_object_[0][2]*_normal[0] + to_object_[1][2]*_normal[1] + to_object_[2][2]*_normal[2]));
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Instance::intersect(const Ray& _ray,
+                         vec3&      _intersection_point,
+                         vec3&      _intersection_normal,
+                         Scalar&    _intersection_t) const
+{
+    if (!mesh_->intersect(to_object(_ray), _intersection_point, _intersection_normal, _intersection_t))
+        return false;
+
+    // the point is computed from the original ray, which is more accurate
+    // than transforming the point back
+    _intersection_point  = _ray(_intersection_t);
+    _intersection_normal = normal_to_world(_intersection_normal);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Instance::intersect_packet(const RayPacket& _packet,
+                                const bool        _lanes[],
+                                bool              _hit[],
+                                vec3              _intersection_point[],
+                                vec3              _intersection_normal[],
+                                Scalar            _intersection_t[]) const
+{
+    RayPacket packet;
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        if (_lanes[l]) packet.set(l, to_object(_packet.rays[l]));
+    }
+
+    mesh_->intersect_packet(packet, _lanes, _hit, _intersection_point,
+                            _intersection_normal, _intersection_t);
+
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        if (_lanes[l] && _hit[l])
+        {
+            _intersection_point[l]  = _packet.rays[l](_intersection_t[l]);
+            _intersection_normal[l] = normal_to_world(_intersection_normal[l]);
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Instance::occluded(const Ray& _ray, Scalar _tmax) const
+{
+    return mesh_->occluded(to_object(_ray), _tmax);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Instance::bounds(vec3& _bb_min, vec3& _bb_max) const
+{
+    vec3 lo, hi;
+    if (!mesh_->bounds(lo, hi)) return false;
+
+    // an empty mesh keeps its empty box
+    if (lo[0] > hi[0])
+    {
+        _bb_min = lo;
+        _bb_max = hi;
+        return true;
+    }
+
+    // bounding box of the transformed corners
+    _bb_min = vec3(std::numeric_limits<Scalar>::max());
+    _bb_max = vec3(std::numeric_limits<Scalar>::lowest());
+    for (int i = 0; i < 8; ++i)
+    {
+        const vec3 corner(i & 1 ? hi[0] : lo[0], i & 2 ? hi[1] : lo[1], i & 4 ? hi[2] : lo[2]);
+        const vec3 p = transform_point(to_world_, corner);
+        _bb_min = min(_bb_min, p);
+        _bb_max = max(_bb_max, p);
+    }
+    return true;
+}
+
+
+//=============================================================================
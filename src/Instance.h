@@ -0,0 +1,96 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+
+//== INCLUDES =================================================================
+
+#include "Object.h"
+#include "Mesh.h"
+
+#include <memory>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Instance Instance.h
+/// This class places a mesh in the scene with an affine transformation and
+/// its own material. The mesh, including its bounding volume hierarchy, is
+/// shared by all instances of it and stays in its own coordinate system
+/// ("object space"): rays are transformed into object space for the
+/// intersection, and the results are transformed back.
+class Instance final : public Object
+{
+public:
+    /// Construct an instance of \c _mesh with transformation and material
+    /// parsed from an input stream, see parse().
+    Instance(std::shared_ptr<const Mesh> _mesh, std::istream &is);
+
+    /// Intersect the transformed mesh with \c _ray. The ray parameter is the
+    /// same in object space, so the results are those of Mesh::intersect()
+    /// transformed to the scene.
+    /// This function overrides Object::intersect().
+    virtual bool intersect(const Ray& _ray,
+                           vec3&      _intersection_point,
+                           vec3&      _intersection_normal,
+                           Scalar&    _intersection_t) const override;
+
+    /// Transform the rays of the packet into object space and intersect them
+    /// with the mesh together, see Mesh::intersect_packet().
+    /// This function overrides Object::intersect_packet().
+    virtual void intersect_packet(const RayPacket& _packet,
+                                  const bool        _lanes[],
+                                  bool              _hit[],
+                                  vec3              _intersection_point[],
+                                  vec3              _intersection_normal[],
+                                  Scalar            _intersection_t[]) const override;
+
+    /// Is the transformed mesh hit by \c _ray before \c _tmax?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray, Scalar _tmax) const override;
+
+    /// Bounding box of the transformed bounding box of the mesh.
+    /// This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override;
+
+    /// Parse the transformation, a 4x4 matrix in row-major order whose last
+    /// row has to be (0 0 0 1), followed by the material
+    virtual void parse(std::istream &is) override;
+
+    /// The shared mesh
+    const Mesh& mesh() const { return *mesh_; }
+
+private:
+    /// \c _ray in object space. Its direction is not normalized, such that
+    /// ray parameters are the same in object space and in the scene.
+    Ray to_object(const Ray& _ray) const;
+
+    /// Transform a normal from object space to the scene
+    vec3 normal_to_world(const vec3& _normal) const;
+
+private:
+    /// the mesh, shared with the other instances of it
+    std::shared_ptr<const Mesh> mesh_;
+
+    /// transformation from object space to the scene: first three rows of
+    /// the 4x4 matrix
+    Scalar to_world_[3][4];
+
+    /// inverse transformation, from the scene to object space
+    Scalar to_object_[3][4];
+};
+
+
+//=============================================================================
+#endif // INSTANCE_H defined
+//=============================================================================
@@ -0,0 +1,105 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else // Unix
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+// Empty files cannot be mapped, but are valid files; they are represented
+// by this (empty) buffer.
+static const char empty_file[1] = { 0 };
+
+
+//-----------------------------------------------------------------------------
+
+
+MappedFile::MappedFile(const std::string& _filename)
+{
+#ifdef _WIN32 // Windows
+    HANDLE file = CreateFileA(_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    file_ = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) return;
+    if (size.QuadPart == 0)
+    {
+        data_ = empty_file;
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return;
+    mapping_ = mapping;
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) return;
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<size_t>(size.QuadPart);
+#else // Unix
+    const int fd = open(_filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        if (st.st_size == 0)
+        {
+            data_ = empty_file;
+        }
+        else
+        {
+            void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                // the file is read front to back exactly once
+                madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(data);
+                size_ = static_cast<size_t>(st.st_size);
+            }
+        }
+    }
+
+    // the mapping stays valid after closing the file
+    close(fd);
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32 // Windows
+    if (data_ && data_ != empty_file) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_)    CloseHandle(file_);
+#else // Unix
+    if (data_ && data_ != empty_file) munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+
+//=============================================================================
@@ -0,0 +1,113 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+
+//== INCLUDES =================================================================
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class MappedFile MappedFile.h
+/// This class maps a whole file into memory for reading, so that it can be
+/// parsed in place, without copying it into a buffer first. The contents are
+/// available through data() and size() as long as the object exists.
+class MappedFile
+{
+public:
+
+    /// Map the file \c _filename. Check is_open() for success.
+    explicit MappedFile(const std::string& _filename);
+
+    /// Unmap the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Could the file be opened and mapped?
+    bool is_open() const { return data_ != nullptr; }
+
+    /// first byte of the file
+    const char* data() const { return data_; }
+
+    /// size of the file in bytes
+    size_t size() const { return size_; }
+
+    /// one past the last byte of the file
+    const char* end() const { return data_ + size_; }
+
+private:
+
+    /// the mapped contents
+    const char* data_ = nullptr;
+
+    /// size of the file in bytes
+    size_t size_ = 0;
+
+#ifdef _WIN32
+    /// file and mapping handles
+    void* file_    = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// Write the elements of \c _array to the binary stream \c _os, preceded by
+/// their number and size, such that read_array() can read them back.
+template <class T>
+void write_array(std::ostream& _os, const std::vector<T>& _array)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "elements are written as bytes");
+    const uint64_t header[2] = { _array.size(), sizeof(T) };
+    _os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    _os.write(reinterpret_cast<const char*>(_array.data()),
+              static_cast<std::streamsize>(_array.size() * sizeof(T)));
+}
+
+
+/// Copy an array written by write_array() from the memory [_p, _end), e.g.
+/// a MappedFile, to \c _array and advance \c _p behind it. Return false if
+/// the data is truncated or was written with a different element size.
+template <class T>
+bool read_array(const char*& _p, const char* _end, std::vector<T>& _array)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "elements are read as bytes");
+    uint64_t header[2];
+    if (static_cast<size_t>(_end - _p) < sizeof(header)) return false;
+    std::memcpy(header, _p, sizeof(header));
+    const size_t available = static_cast<size_t>(_end - _p) - sizeof(header);
+    if (header[1] != sizeof(T) || header[0] > available / sizeof(T)) return false;
+    _p += sizeof(header);
+
+    _array.resize(static_cast<size_t>(header[0]));
+    if (!_array.empty()) std::memcpy(_array.data(), _p, _array.size() * sizeof(T));
+    _p += _array.size() * sizeof(T);
+    return true;
+}
+
+
+//=============================================================================
+#endif // MAPPEDFILE_H defined
+//=============================================================================
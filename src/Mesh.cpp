@@ -11,21 +11,283 @@
 //== INCLUDES =================================================================
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "StopWatch.h"
+#include "Statistics.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+#include <charconv>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <string>
 #include <stdexcept>
 #include <limits>
 #include <cmath>
 
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#endif
+
 
 //== IMPLEMENTATION ===========================================================
 
 
+// Where the compiler supports it, the triangle kernel below is compiled twice,
+// for plain x86-64 (SSE2) and for AVX2, and the loader picks the version the
+// CPU supports. Both compute the same IEEE results. The kernel is not an
+// 8-wide AVX2 kernel: it has Mesh::TRIANGLE_LANES = BVH::MAX_LEAF_SIZE = 4
+// lanes, since it tests one leaf of the hierarchy at a time. With AVX2 that
+// is one ymm register of doubles, or half of one of floats.
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#  if __has_attribute(target_clones)
+#    define TRIANGLE_KERNEL_TARGETS __attribute__((target_clones("avx2", "default")))
+#  endif
+#endif
+#ifndef TRIANGLE_KERNEL_TARGETS
+#  define TRIANGLE_KERNEL_TARGETS
+#endif
+
+
+/// Moeller-Trumbore test of one ray against the Mesh::TRIANGLE_LANES
+/// triangles of a block, written as a branch-free loop over the triangles so
+/// that it is vectorized. The arithmetic is exactly that of
+/// Mesh::intersect_triangle(), see there.
+TRIANGLE_KERNEL_TARGETS
+static unsigned int intersect_triangle_block(const Mesh::TriangleBlock& _block,
+                                             const vec3& _origin, const vec3& _direction,
+                                             Scalar* _t)
+{
+    const Scalar o0 = _origin[0],    o1 = _origin[1],    o2 = _origin[2];
+    const Scalar d0 = _direction[0], d1 = _direction[1], d2 = _direction[2];
+
+    // results are collected locally, so that the compiler knows that the
+    // loop does not write to its input
+    Scalar tl[Mesh::TRIANGLE_LANES];
+    int hit[Mesh::TRIANGLE_LANES];
+
+    for (unsigned int l = 0; l < Mesh::TRIANGLE_LANES; ++l)
+    {
+        const Scalar e10 = _block.edge1[0][l], e11 = _block.edge1[1][l], e12 = _block.edge1[2][l];
+        const Scalar e20 = _block.edge2[0][l], e21 = _block.edge2[1][l], e22 = _block.edge2[2][l];
+
+        // h = cross(direction, edge2), a = dot(edge1, h)
+        const Scalar h0 = d1*e22 - d2*e21;
+        const Scalar h1 = d2*e20 - d0*e22;
+        const Scalar h2 = d0*e21 - d1*e20;
+        const Scalar a  = e10*h0 + e11*h1 + e12*h2;
+        const Scalar f  = Scalar(1) / a;
+
+        // s = origin - p0, beta = f * dot(s, h)
+        const Scalar s0 = o0 - _block.p0[0][l];
+        const Scalar s1 = o1 - _block.p0[1][l];
+        const Scalar s2 = o2 - _block.p0[2][l];
+        const Scalar beta = f * (s0*h0 + s1*h1 + s2*h2);
+
+        // q = cross(s, edge1), gamma = f * dot(direction, q), t = f * dot(q, edge2)
+        const Scalar q0 = s1*e12 - s2*e11;
+        const Scalar q1 = s2*e10 - s0*e12;
+        const Scalar q2 = s0*e11 - s1*e10;
+        const Scalar gamma = f * (d0*q0 + d1*q1 + d2*q2);
+        const Scalar t     = f * (q0*e20 + q1*e21 + q2*e22);
+
+        // the rejection tests of intersect_triangle(), in the same form but
+        // without short-circuit evaluation (which would prevent vectorization)
+        hit[l] = !((a > -Mesh::EPSILON) & (a < Mesh::EPSILON)) &
+                 !((beta < 0) | (beta > 1)) &
+                 !((gamma < 0) | (beta + gamma > 1)) &
+                 !(t < Mesh::EPSILON);
+        tl[l] = t;
+    }
+
+    unsigned int mask = 0;
+    for (unsigned int l = 0; l < Mesh::TRIANGLE_LANES; ++l)
+    {
+        _t[l] = tl[l];
+        mask |= static_cast<unsigned int>(hit[l]) << l;
+    }
+    return mask;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+// The OFF parser in Mesh::read() works in place on the mapped file. The
+// following helpers advance the read position _p, but never beyond _end.
+
+
+/// Skip white space and comments (from '#' to the end of the line)
+static void skip_space(const char*& _p, const char* _end)
+{
+    while (_p != _end)
+    {
+        if (*_p == '#')
+        {
+            while (_p != _end && *_p != '\n') ++_p;
+        }
+        else if (*_p == ' ' || *_p == '\n' || *_p == '\r' || *_p == '\t')
+        {
+            ++_p;
+        }
+        else break;
+    }
+}
+
+
+/// Skip the rest of the current line
+static void skip_line(const char*& _p, const char* _end)
+{
+    while (_p != _end && *_p != '\n') ++_p;
+}
+
+
+/// Parse an unsigned integer, return false if there is none
+static bool parse_number(const char*& _p, const char* _end, unsigned int& _value)
+{
+    skip_space(_p, _end);
+    if (_p != _end && *_p == '+') ++_p;
+    const std::from_chars_result result = std::from_chars(_p, _end, _value);
+    if (result.ec != std::errc()) return false;
+    _p = result.ptr;
+    return true;
+}
+
+
+/// Parse a floating point number, return false if there is none
+static bool parse_number(const char*& _p, const char* _end, Scalar& _value)
+{
+    skip_space(_p, _end);
+    if (_p != _end && *_p == '+') ++_p;
+#ifdef __cpp_lib_to_chars
+    const std::from_chars_result result = std::from_chars(_p, _end, _value);
+    if (result.ec != std::errc()) return false;
+    _p = result.ptr;
+    return true;
+#else
+    // older standard libraries only parse integers with from_chars: use
+    // strtod on a terminated copy of the number instead
+    char buffer[64];
+    size_t n = 0;
+    while (_p + n != _end && n + 1 < sizeof(buffer) &&
+           _p[n] != ' ' && _p[n] != '\n' && _p[n] != '\r' && _p[n] != '\t')
+    {
+        buffer[n] = _p[n];
+        ++n;
+    }
+    buffer[n] = 0;
+    char* last;
+    const double value = std::strtod(buffer, &last);
+    if (last == buffer) return false;
+    _value = static_cast<Scalar>(value);
+    _p += last - buffer;
+    return true;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// 64 bit FNV-1a hash of the bytes [_p, _end), which identifies the contents
+/// of a mesh file in its cache
+static uint64_t hash_bytes(const char* _p, const char* _end)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (; _p != _end; ++_p)
+    {
+        hash ^= static_cast<unsigned char>(*_p);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+/// Modification time of the file \c _filename in ticks of the clock of the
+/// file system, or 0 if it cannot be determined
+static int64_t modification_time(const std::string& _filename)
+{
+    std::error_code error;
+    const auto time = std::filesystem::last_write_time(_filename, error);
+    return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+
+/// Header of a mesh cache file. It holds everything the cached data depends
+/// on, and a cache file is only used if its header is the expected one.
+struct MeshCacheHeader
+{
+    /// file type, "RTMESH" followed by zeros
+    char magic[8];
+    /// version of the file format, to be increased whenever Mesh or BVH
+    /// change what they store
+    uint32_t version;
+    /// 0x01020304 in the byte order of the writer
+    uint32_t byte_order;
+    /// size of Scalar in bytes
+    uint32_t scalar_size;
+    /// BVH::Quality of the cached hierarchy
+    uint32_t quality;
+    /// size of the mesh file in bytes
+    uint64_t source_size;
+    /// modification_time() of the mesh file
+    int64_t source_mtime;
+    /// hash_bytes() of the mesh file
+    uint64_t source_hash;
+};
+
+
+/// Header of the cache of a mesh file with the given size, modification
+/// time, and hash
+static MeshCacheHeader mesh_cache_header(uint64_t _source_size, int64_t _source_mtime,
+                                         uint64_t _source_hash, BVH::Quality _quality)
+{
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "RTMESH", 6);
+    header.version     = 2;
+    header.byte_order  = 0x01020304;
+    header.scalar_size = sizeof(Scalar);
+    header.quality     = static_cast<uint32_t>(_quality);
+    header.source_size  = _source_size;
+    header.source_mtime = _source_mtime;
+    header.source_hash  = _source_hash;
+    return header;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 Mesh::Mesh(std::istream& is, const std::string& scenePath)
 {
-    std::string meshFile, mode;
-    is >> meshFile;
+    std::string meshFile;
+    is >> meshFile >> draw_mode_ >> material;
+
+    // the mesh is loaded from this file (or its cache) once the scene is read
+    filename_ = path(meshFile, scenePath);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Mesh::Mesh(const std::string& _filename, Draw_mode _draw_mode)
+: filename_(_filename), draw_mode_(_draw_mode)
+{
+}
 
+
+//-----------------------------------------------------------------------------
+
+
+std::string Mesh::path(const std::string& _meshFile, const std::string& _scenePath)
+{
     const char pathSep =
 #ifdef _WIN32
         '\\';
@@ -33,15 +295,7 @@ Mesh::Mesh(std::istream& is, const std::string& scenePath)
                             '/';
 #endif
 
-    // load mesh from file
-    read(scenePath.substr(0, scenePath.find_last_of(pathSep) + 1) + meshFile);
-
-    is >> mode;
-    if (mode == "FLAT") draw_mode_ = FLAT;
-    else if (mode == "PHONG") draw_mode_ = PHONG;
-    else throw std::runtime_error("Invalid draw mode " + mode);
-
-    is >> material;
+    return _scenePath.substr(0, _scenePath.find_last_of(pathSep) + 1) + _meshFile;
 }
 
 
@@ -50,55 +304,103 @@ Mesh::Mesh(std::istream& is, const std::string& scenePath)
 
 bool Mesh::read(const std::string& _filename)
 {
-    // read a mesh in OFF format
+    // read a mesh in OFF format, parsing the memory-mapped file in a single
+    // pass without any intermediate copies
+
+    Profiler::Scope scope("parse");
+    PerfCounters::Scope counters("load");
+    StopWatch timer;
+    timer.start();
+
+
+    // a mesh that is rejected is left empty, with an empty bounding box,
+    // instead of with the triangles read so far, and without the numbers of
+    // a file read before
+    auto reject = [&](const std::string& _message) {
+        std::cerr << _message << "\n";
+        vertices_.clear();
+        triangles_.clear();
+        compute_bounding_box();
+        source_size_  = 0;
+        source_mtime_ = 0;
+        source_hash_  = 0;
+        parse_rate_   = 0;
+        return false;
+    };
 
 
-    // open file
-    std::ifstream ifs(_filename);
-    if (!ifs)
-    {
-        std::cerr << "Can't open " << _filename << "\n";
-        return false;
-    }
+    // map file, its modification time is taken first, so that a change
+    // while it is read outdates the cache
+    const int64_t mtime = modification_time(_filename);
+    MappedFile file(_filename);
+    if (!file.is_open())
+        return reject("Can't open " + _filename);
+    const char* p   = file.data();
+    const char* end = file.end();
 
 
     // read OFF header
-    std::string s;
-    unsigned int nV, nF, dummy, i;
-    ifs >> s;
-    if (s != "OFF")
-    {
-        std::cerr << "No OFF file\n";
-        return false;
-    }
-    ifs >> nV >> nF >> dummy;
-    std::cout << "\n  read " << _filename << ": " << nV << " vertices, " << nF << " triangles";
+    unsigned int nV, nF, nE;
+    skip_space(p, end);
+    if (end - p < 3 || p[0] != 'O' || p[1] != 'F' || p[2] != 'F')
+        return reject("No OFF file");
+    p += 3;
+    if (!parse_number(p, end, nV) || !parse_number(p, end, nF) || !parse_number(p, end, nE))
+        return reject("Invalid OFF header in " + _filename);
+
+    // every vertex has 3 numbers and every face at least 4, of at least one
+    // byte each, so larger counts cannot be right and are not allocated
+    if (3 * uint64_t(nV) + 4 * uint64_t(nF) > uint64_t(end - p))
+        return reject("Too many vertices or faces for the size of " + _filename);
 
 
     // read vertices
-    Vertex v;
-    vertices_.clear();
-    vertices_.reserve(nV);
-    for (i = 0; i < nV; ++i)
+    vertices_.resize(nV);
+    for (Vertex& v : vertices_)
     {
-        ifs >> v.position;
-        vertices_.push_back(v);
+        if (!parse_number(p, end, v.position[0]) ||
+            !parse_number(p, end, v.position[1]) ||
+            !parse_number(p, end, v.position[2]))
+        {
+            return reject("Invalid vertex in " + _filename);
+        }
     }
 
 
-    // read triangles
+    // read faces, polygons with n > 3 vertices are split into a fan of
+    // n - 2 triangles around their first vertex
     Triangle t;
     triangles_.clear();
     triangles_.reserve(nF);
-    for (i = 0; i < nF; ++i)
+    for (unsigned int i = 0; i < nF; ++i)
     {
-        ifs >> dummy >> t.i0 >> t.i1 >> t.i2;
-        triangles_.push_back(t);
-    }
+        unsigned int n, i0, i1, i2;
+        bool valid = parse_number(p, end, n) && n >= 3 &&
+                     parse_number(p, end, i0) && parse_number(p, end, i1) &&
+                     i0 < nV && i1 < nV;
+        for (unsigned int k = 2; valid && k < n; ++k)
+        {
+            valid = parse_number(p, end, i2) && i2 < nV;
+            if (!valid) break;
+            t.i0 = i0;
+            t.i1 = i1;
+            t.i2 = i2;
+            triangles_.push_back(t);
+            i1 = i2;
+        }
+        if (!valid)
+            return reject("Invalid face in " + _filename);
 
+        // ignore anything else on the line, e.g. a face color
+        skip_line(p, end);
+    }
+    const double parse_ms = timer.stop();
+    parse_rate_ = parse_ms > 0 ? file.size() / 1e3 / parse_ms : 0;
 
-    // close file
-    ifs.close();
+    // identifies the file in its cache
+    source_size_  = file.size();
+    source_mtime_ = mtime;
+    source_hash_  = hash_bytes(file.data(), file.end());
 
 
     // compute face and vertex normals
@@ -107,6 +409,7 @@ bool Mesh::read(const std::string& _filename)
     // compute bounding box
     compute_bounding_box();
 
+    load_time_ = timer.stop();
 
     return true;
 }
@@ -127,9 +430,9 @@ void angleWeights(const vec3& p0, const vec3& p1, const vec3& p2,
     const vec3 e01 = normalize(p1 - p0);
     const vec3 e12 = normalize(p2 - p1);
     const vec3 e20 = normalize(p0 - p2);
-    w0 = acos(std::max(-1.0, std::min(1.0, dot(e01, -e20))));
-    w1 = acos(std::max(-1.0, std::min(1.0, dot(e12, -e01))));
-    w2 = acos(std::max(-1.0, std::min(1.0, dot(e20, -e12))));
+    w0 = acos(std::max(Scalar(-1), std::min(Scalar(1), dot(e01, -e20))));
+    w1 = acos(std::max(Scalar(-1), std::min(Scalar(1), dot(e12, -e01))));
+    w2 = acos(std::max(Scalar(-1), std::min(Scalar(1), dot(e20, -e12))));
 }
 
 
@@ -137,6 +440,8 @@ void angleWeights(const vec3& p0, const vec3& p1, const vec3& p2,
 
 void Mesh::compute_normals()
 {
+    Profiler::Scope scope("normals");
+
     // compute triangle normals
     for (Triangle& t : triangles_)
     {
@@ -171,8 +476,8 @@ void Mesh::compute_normals()
 
 void Mesh::compute_bounding_box()
 {
-    bb_min_ = vec3(std::numeric_limits<double>::max());
-    bb_max_ = vec3(std::numeric_limits<double>::lowest());
+    bb_min_ = vec3(std::numeric_limits<Scalar>::max());
+    bb_max_ = vec3(std::numeric_limits<Scalar>::lowest());
 
     for (Vertex v : vertices_)
     {
@@ -185,16 +490,213 @@ void Mesh::compute_bounding_box()
 //-----------------------------------------------------------------------------
 
 
+void Mesh::build_bvh(BVH::Quality _quality)
+{
+    std::vector<vec3> bb_min(triangles_.size()), bb_max(triangles_.size());
+    for (size_t i = 0; i < triangles_.size(); ++i)
+    {
+        const vec3& p0 = vertices_[triangles_[i].i0].position;
+        const vec3& p1 = vertices_[triangles_[i].i1].position;
+        const vec3& p2 = vertices_[triangles_[i].i2].position;
+        bb_min[i] = min(p0, min(p1, p2));
+        bb_max[i] = max(p0, max(p1, p2));
+    }
+
+    bvh_.build(bb_min, bb_max, _quality);
+
+    // copy the triangles of each leaf into a block, in depth-first order
+    blocks_.clear();
+    leaf_block_.assign(bvh_.num_primitives(), 0);
+    bvh_.for_each_leaf([&](unsigned int first, unsigned int count) {
+        leaf_block_[first] = static_cast<unsigned int>(blocks_.size());
+        TriangleBlock& block = blocks_.emplace_back();
+        for (unsigned int l = 0; l < TRIANGLE_LANES; ++l)
+        {
+            // unused lanes get a degenerate triangle at the origin
+            vec3 p0(0, 0, 0), edge1(0, 0, 0), edge2(0, 0, 0);
+            unsigned int i = 0;
+            if (l < count)
+            {
+                i = bvh_.primitive(first + l);
+                const Triangle& triangle = triangles_[i];
+                p0    = vertices_[triangle.i0].position;
+                edge1 = vertices_[triangle.i1].position - p0;
+                edge2 = vertices_[triangle.i2].position - p0;
+            }
+            for (int j = 0; j < 3; ++j)
+            {
+                block.p0[j][l]    = p0[j];
+                block.edge1[j][l] = edge1[j];
+                block.edge2[j][l] = edge2[j];
+            }
+            block.index[l] = i;
+        }
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::read_cache(BVH::Quality _quality)
+{
+    Profiler::Scope scope("cache");
+    PerfCounters::Scope counters("load");
+    StopWatch timer;
+    timer.start();
+
+    // The cache has to match the current contents of the mesh file. A file
+    // of the same size and modification time is taken to be unchanged, and
+    // only if the time differs (e.g. after copying the file or checking it
+    // out again) is the file read and hashed to compare its contents.
+    std::error_code error;
+    const uint64_t source_size  = std::filesystem::file_size(filename_, error);
+    const int64_t  source_mtime = modification_time(filename_);
+    if (error) return false;
+
+    const std::string cacheFile = filename_ + ".cache";
+    MappedFile file(cacheFile);
+    MeshCacheHeader header;
+    if (!file.is_open() || file.size() < sizeof(header)) return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    const MeshCacheHeader expected = mesh_cache_header(source_size, header.source_mtime,
+                                                       header.source_hash, _quality);
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) return false;
+    if (header.source_mtime != source_mtime)
+    {
+        MappedFile source(filename_);
+        if (!source.is_open() || hash_bytes(source.data(), source.end()) != header.source_hash)
+            return false;
+    }
+
+    // the arrays are stored one after the other, exactly as they are in memory
+    const char* p   = file.data() + sizeof(header);
+    const char* end = file.end();
+    bool valid = read_array(p, end, vertices_) &&
+                 read_array(p, end, triangles_) &&
+                 bvh_.read(p, end) &&
+                 read_array(p, end, blocks_) &&
+                 read_array(p, end, leaf_block_) &&
+                 p == end;
+
+    // all indices have to be in range, such that a damaged cache cannot
+    // crash the ray tracer
+    const size_t nV = vertices_.size(), nT = triangles_.size();
+    valid = valid && bvh_.num_primitives() == nT && leaf_block_.size() == nT;
+    for (size_t i = 0; valid && i < nT; ++i)
+    {
+        const Triangle& t = triangles_[i];
+        valid = t.i0 >= 0 && t.i1 >= 0 && t.i2 >= 0 &&
+                size_t(t.i0) < nV && size_t(t.i1) < nV && size_t(t.i2) < nV &&
+                bvh_.primitive(unsigned(i)) < nT && leaf_block_[i] < blocks_.size();
+    }
+    for (size_t i = 0; valid && i < blocks_.size(); ++i)
+    {
+        for (unsigned int l = 0; valid && l < TRIANGLE_LANES; ++l)
+            valid = blocks_[i].index[l] < nT;
+    }
+
+    if (!valid)
+    {
+        vertices_.clear();
+        triangles_.clear();
+        bvh_ = BVH();
+        blocks_.clear();
+        leaf_block_.clear();
+        return false;
+    }
+
+    source_size_  = header.source_size;
+    source_mtime_ = source_mtime;
+    source_hash_  = header.source_hash;
+    parse_rate_  = 0;
+    compute_bounding_box();
+
+    load_time_ = timer.stop();
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::write_cache(BVH::Quality _quality) const
+{
+    const MeshCacheHeader header = mesh_cache_header(source_size_, source_mtime_, source_hash_, _quality);
+
+    // the triangles and blocks have padding bytes, which are written as zeros
+    std::vector<Triangle> triangles(triangles_.size());
+    std::memset(static_cast<void*>(triangles.data()), 0, triangles.size() * sizeof(Triangle));
+    for (size_t i = 0; i < triangles_.size(); ++i)
+    {
+        triangles[i].i0     = triangles_[i].i0;
+        triangles[i].i1     = triangles_[i].i1;
+        triangles[i].i2     = triangles_[i].i2;
+        triangles[i].normal = triangles_[i].normal;
+    }
+    std::vector<TriangleBlock> blocks(blocks_.size());
+    std::memset(static_cast<void*>(blocks.data()), 0, blocks.size() * sizeof(TriangleBlock));
+    for (size_t i = 0; i < blocks_.size(); ++i)
+    {
+        std::memcpy(blocks[i].p0,    blocks_[i].p0,    sizeof(blocks_[i].p0));
+        std::memcpy(blocks[i].edge1, blocks_[i].edge1, sizeof(blocks_[i].edge1));
+        std::memcpy(blocks[i].edge2, blocks_[i].edge2, sizeof(blocks_[i].edge2));
+        std::memcpy(blocks[i].index, blocks_[i].index, sizeof(blocks_[i].index));
+    }
+
+    // Write to a temporary file first and rename it once it is complete, such
+    // that an interrupted write cannot leave a truncated cache behind. The
+    // temporary file is named after the process, so that programs writing
+    // the same cache at the same time do not write to the same file.
+    const std::string cacheFile = filename_ + ".cache";
+    const std::string tempFile  = cacheFile + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream ofs(tempFile, std::ios::binary);
+        if (!ofs) return false;
+
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_array(ofs, vertices_);
+        write_array(ofs, triangles);
+        bvh_.write(ofs);
+        write_array(ofs, blocks);
+        write_array(ofs, leaf_block_);
+
+        if (!ofs.flush())
+        {
+            ofs.close();
+            std::remove(tempFile.c_str());
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    std::remove(cacheFile.c_str());
+#endif
+    if (std::rename(tempFile.c_str(), cacheFile.c_str()) != 0)
+    {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 bool Mesh::intersect_bounding_box(const Ray& _ray) const
 {
+    Statistics::count(Statistics::BOX_TESTS);
+
     // Initialize tmin and tmax to the interval of the ray
-    double tmin = (bb_min_[0] - _ray.origin[0]) / _ray.direction[0];
-    double tmax = (bb_max_[0] - _ray.origin[0]) / _ray.direction[0];
+    Scalar tmin = (bb_min_[0] - _ray.origin[0]) / _ray.direction[0];
+    Scalar tmax = (bb_max_[0] - _ray.origin[0]) / _ray.direction[0];
 
     if (tmin > tmax) std::swap(tmin, tmax);
 
-    double tymin = (bb_min_[1] - _ray.origin[1]) / _ray.direction[1];
-    double tymax = (bb_max_[1] - _ray.origin[1]) / _ray.direction[1];
+    Scalar tymin = (bb_min_[1] - _ray.origin[1]) / _ray.direction[1];
+    Scalar tymax = (bb_max_[1] - _ray.origin[1]) / _ray.direction[1];
 
     if (tymin > tymax) std::swap(tymin, tymax);
 
@@ -208,8 +710,8 @@ bool Mesh::intersect_bounding_box(const Ray& _ray) const
     if (tymax < tmax)
         tmax = tymax;
 
-    double tzmin = (bb_min_[2] - _ray.origin[2]) / _ray.direction[2];
-    double tzmax = (bb_max_[2] - _ray.origin[2]) / _ray.direction[2];
+    Scalar tzmin = (bb_min_[2] - _ray.origin[2]) / _ray.direction[2];
+    Scalar tzmax = (bb_max_[2] - _ray.origin[2]) / _ray.direction[2];
 
     if (tzmin > tzmax) std::swap(tzmin, tzmax);
 
@@ -233,7 +735,7 @@ bool Mesh::intersect_bounding_box(const Ray& _ray) const
 bool Mesh::intersect(const Ray& _ray,
                      vec3& _intersection_point,
                      vec3& _intersection_normal,
-                     double& _intersection_t) const
+                     Scalar& _intersection_t) const
 {
     // check bounding box intersection
     if (!intersect_bounding_box(_ray))
@@ -242,11 +744,45 @@ bool Mesh::intersect(const Ray& _ray,
     }
 
     vec3 p, n;
-    double t;
+    Scalar t;
 
     _intersection_t = NO_INTERSECTION;
 
+    if (use_bvh_ && !bvh_.empty())
+    {
+        // only test the triangles in the hierarchy's leaves that are hit,
+        // front to back, and skip everything behind the closest hit. Equally
+        // close hits are resolved like in the linear search below.
+        unsigned int closest = 0;
+        const bool hit = bvh_.intersect_leaves(_ray, _intersection_t,
+                                               [&](unsigned int first, unsigned int count, Scalar& tmax) {
+            Statistics::count(Statistics::TRIANGLE_TESTS, count);
+            const TriangleBlock& block = blocks_[leaf_block_[first]];
+            Scalar tl[TRIANGLE_LANES];
+            const unsigned int mask = intersect_triangles(block, _ray, tl);
+            bool accepted = false;
+            for (unsigned int l = 0; l < count; ++l)
+            {
+                const unsigned int i = block.index[l];
+                if ((mask >> l & 1) && (tl[l] < tmax || (tl[l] == tmax && i < closest)))
+                {
+                    tmax = tl[l];
+                    closest = i;
+                    accepted = true;
+                }
+            }
+            return accepted;
+        });
+
+        // point and normal only for the closest hit
+        if (hit)
+            intersect_triangle(triangles_[closest], _ray,
+                               _intersection_point, _intersection_normal, _intersection_t);
+        return hit;
+    }
+
     // for each triangle
+    Statistics::count(Statistics::TRIANGLE_TESTS, triangles_.size());
     for (const Triangle& triangle : triangles_)
     {
         // does ray intersect triangle?
@@ -270,11 +806,146 @@ bool Mesh::intersect(const Ray& _ray,
 //-----------------------------------------------------------------------------
 
 
+void Mesh::intersect_packet(const RayPacket& _packet,
+                            const bool        _lanes[],
+                            bool              _hit[],
+                            vec3              _intersection_point[],
+                            vec3              _intersection_normal[],
+                            Scalar            _intersection_t[]) const
+{
+    if (!use_bvh_ || bvh_.empty())
+    {
+        Object::intersect_packet(_packet, _lanes, _hit, _intersection_point,
+                                 _intersection_normal, _intersection_t);
+        return;
+    }
+
+    // lanes whose rays hit the bounding box of the mesh
+    bool lanes[RayPacket::SIZE];
+    Scalar tmin[RayPacket::SIZE];
+    unsigned int closest[RayPacket::SIZE];
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        lanes[l] = _lanes[l] && intersect_bounding_box(_packet.rays[l]);
+        tmin[l] = NO_INTERSECTION;
+        closest[l] = 0;
+        _hit[l] = false;
+    }
+
+    // find the closest triangle of each lane like intersect() does
+    bvh_.intersect_leaves(_packet, lanes, tmin,
+                          [&](unsigned int first, unsigned int count, const bool* active, Scalar* tmax) {
+        const TriangleBlock& block = blocks_[leaf_block_[first]];
+        Scalar tl[TRIANGLE_LANES];
+        for (int l = 0; l < RayPacket::SIZE; ++l)
+        {
+            if (!active[l]) continue;
+            Statistics::count(Statistics::TRIANGLE_TESTS, count);
+            const unsigned int mask = intersect_triangles(block, _packet.rays[l], tl);
+            for (unsigned int j = 0; j < count; ++j)
+            {
+                const unsigned int i = block.index[j];
+                if ((mask >> j & 1) && (tl[j] < tmax[l] || (tl[j] == tmax[l] && i < closest[l])))
+                {
+                    tmax[l] = tl[j];
+                    closest[l] = i;
+                    _hit[l] = true;
+                }
+            }
+        }
+    });
+
+    // shading data only for the closest hits
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        if (_hit[l])
+            intersect_triangle(triangles_[closest[l]], _packet.rays[l],
+                               _intersection_point[l], _intersection_normal[l], _intersection_t[l]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::occluded(const Ray& _ray, Scalar _tmax) const
+{
+    if (!intersect_bounding_box(_ray))
+    {
+        return false;
+    }
+
+    // the first triangle in range will do, and there is no need for
+    // intersection point or normal
+    Scalar t, beta, gamma;
+    auto occluded_triangle = [&](const Triangle& triangle) {
+        return intersect_triangle(triangle, _ray, t, beta, gamma) && t < _tmax;
+    };
+
+    if (use_bvh_ && !bvh_.empty())
+    {
+        return bvh_.occluded_leaves(_ray, _tmax, [&](unsigned int first, unsigned int count) {
+            Statistics::count(Statistics::TRIANGLE_TESTS, count);
+            Scalar tl[TRIANGLE_LANES];
+            const unsigned int mask = intersect_triangles(blocks_[leaf_block_[first]], _ray, tl);
+            for (unsigned int l = 0; l < count; ++l)
+            {
+                if ((mask >> l & 1) && tl[l] < _tmax) return true;
+            }
+            return false;
+        });
+    }
+
+    for (const Triangle& triangle : triangles_)
+    {
+        Statistics::count(Statistics::TRIANGLE_TESTS);
+        if (occluded_triangle(triangle)) return true;
+    }
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 bool Mesh::intersect_triangle(const Triangle& _triangle,
                               const Ray& _ray,
                               vec3& _intersection_point,
                               vec3& _intersection_normal,
-                              double& _intersection_t) const
+                              Scalar& _intersection_t) const
+{
+    Scalar beta, gamme;
+    if (!intersect_triangle(_triangle, _ray, _intersection_t, beta, gamme))
+        return false;
+
+    _intersection_point = _ray.origin + _ray.direction * _intersection_t;
+
+    if (draw_mode_ == FLAT)
+    {
+        // Use triangle normal
+        _intersection_normal = _triangle.normal;
+    }
+    else // DrawMode::PHONG
+    {
+        // Interpolate vertex normals
+        const vec3& n0 = vertices_[_triangle.i0].normal;
+        const vec3& n1 = vertices_[_triangle.i1].normal;
+        const vec3& n2 = vertices_[_triangle.i2].normal;
+        _intersection_normal = normalize((1 - beta - gamme) * n0 + beta * n1 + gamme * n2);
+    }
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::intersect_triangle(const Triangle& _triangle,
+                              const Ray& _ray,
+                              Scalar& _t,
+                              Scalar& _beta,
+                              Scalar& _gamma) const
 {
     const vec3& p0 = vertices_[_triangle.i0].position;
     const vec3& p1 = vertices_[_triangle.i1].position;
@@ -283,49 +954,43 @@ bool Mesh::intersect_triangle(const Triangle& _triangle,
     vec3 edge1 = p1 - p0;
     vec3 edge2 = p2 - p0;
     vec3 h = cross(_ray.direction, edge2);
-    double a = dot(edge1, h);
+    Scalar a = dot(edge1, h);
     // a = det of a matrix involving the triangle's edges and the ray, f acts as a normalization factor
 
-    if (a > -1e-8 && a < 1e-8) // if the vector is parallel we can skip it (dotprod close to 0)
+    if (a > -EPSILON && a < EPSILON) // if the vector is parallel we can skip it (dotprod close to 0)
         return false;
 
-    double f = 1.0 / a;
+    Scalar f = Scalar(1) / a;
     vec3 s = _ray.origin - p0;
-    double beta = f * dot(s, h);
+    Scalar beta = f * dot(s, h);
 
-    if (beta < 0.0 || beta > 1.0) // The intersection lies outside of the triangle.
+    if (beta < 0 || beta > 1) // The intersection lies outside of the triangle.
         return false;
 
     vec3 q = cross(s, edge1);
-    double gamme = f * dot(_ray.direction, q);
+    Scalar gamme = f * dot(_ray.direction, q);
 
-    if (gamme < 0.0 || beta + gamme > 1.0) // The intersection lies outside of the triangle.
+    if (gamme < 0 || beta + gamme > 1) // The intersection lies outside of the triangle.
         return false;
 
     // Compute t to find the intersection point.
-    double t = f * dot(q, edge2);
+    Scalar t = f * dot(q, edge2);
 
-    if (t < 1e-8) return false; // Intersection is in front of the viewer.
+    if (t < EPSILON) return false; // Intersection is in front of the viewer.
 
-    _intersection_t = t;
-    _intersection_point = _ray.origin + _ray.direction * t;
-
-    if (draw_mode_ == FLAT)
-    {
-        // Use triangle normal
-        _intersection_normal = _triangle.normal;
-    }
-    else // DrawMode::PHONG
-    {
-        // Interpolate vertex normals
-        const vec3& n0 = vertices_[_triangle.i0].normal;
-        const vec3& n1 = vertices_[_triangle.i1].normal;
-        const vec3& n2 = vertices_[_triangle.i2].normal;
-        _intersection_normal = normalize((1 - beta - gamme) * n0 + beta * n1 + gamme * n2);
-    }
+    _t     = t;
+    _beta  = beta;
+    _gamma = gamme;
 
     return true;
 }
 
 
+unsigned int Mesh::intersect_triangles(const TriangleBlock& _block, const Ray& _ray,
+                                       Scalar _t[TRIANGLE_LANES])
+{
+    return intersect_triangle_block(_block, _ray.origin, _ray.direction, _t);
+}
+
+
 //=============================================================================
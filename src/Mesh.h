@@ -15,8 +15,11 @@
 //== INCLUDES =================================================================
 
 #include "Object.h"
+#include "BVH.h"
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <stdexcept>
 
 //== CLASS DEFINITION =========================================================
 
@@ -24,7 +27,7 @@
 /// \class Mesh Mesh.h
 /// This class represents a simple triangle mesh, stored as an indexed face set,
 /// i.e., as an array of vertices and an array of triangles.
-class Mesh : public Object
+class Mesh final : public Object
 {
 public:
 
@@ -33,9 +36,18 @@ public:
 
     /// Construct a mesh by parsing its path and properties from an input
     /// stream. The mesh path read from the file is relative to the 
-    /// scene file's path "scenePath".
+    /// scene file's path "scenePath". The mesh file itself is not read
+    /// yet, see read() and read_cache().
     Mesh(std::istream &is, const std::string &scenePath);
 
+    /// Construct a mesh that is read from \c _filename, without material,
+    /// e.g. one that is shared by instances with their own materials.
+    Mesh(const std::string &_filename, Draw_mode _draw_mode);
+
+    /// Path of a mesh file given as \c _meshFile in the scene file
+    /// \c _scenePath, to which it is relative
+    static std::string path(const std::string &_meshFile, const std::string &_scenePath);
+
     /// Intersect mesh with ray (calls ray-triangle intersection)
     /// If \c _ray intersects a face of the mesh, it provides the following results:
     /// \param[in] _ray the ray to intersect the mesh with
@@ -45,7 +57,35 @@ public:
     virtual bool intersect(const Ray& _ray,
                            vec3&      _intersection_point,
                            vec3&      _intersection_normal,
-                           double&    _intersection_t) const override;
+                           Scalar&    _intersection_t) const override;
+
+    /// Intersect the mesh with the rays of a packet, traversing the bounding
+    /// volume hierarchy with all rays together. Point and normal are only
+    /// computed for the closest triangle of each ray.
+    /// This function overrides Object::intersect_packet().
+    virtual void intersect_packet(const RayPacket& _packet,
+                                  const bool        _lanes[],
+                                  bool              _hit[],
+                                  vec3              _intersection_point[],
+                                  vec3              _intersection_normal[],
+                                  Scalar            _intersection_t[]) const override;
+
+    /// Is any triangle of the mesh hit by \c _ray before \c _tmax?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray, Scalar _tmax) const override;
+
+    /// Bounding box of the mesh. This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override
+    {
+        _bb_min = bb_min_;
+        _bb_max = bb_max_;
+        return true;
+    }
+
+    /// Choose between the bounding volume hierarchy (default) and testing
+    /// every triangle in Mesh::intersect(). The linear search is slow but
+    /// useful as a reference when validating the hierarchy.
+    void set_use_bvh(bool _use_bvh) { use_bvh_ = _use_bvh; }
 
 private:
     /// a vertex consists of a position and a normal
@@ -71,15 +111,56 @@ private:
     };
 
 public:
+    /// Path of the mesh file given in the scene file
+    const std::string& filename() const { return filename_; }
+
+    /// Number of vertices
+    size_t num_vertices() const { return vertices_.size(); }
+
+    /// Number of triangles
+    size_t num_triangles() const { return triangles_.size(); }
+
+    /// Time spent in the last read() or successful read_cache() in ms
+    double load_time() const { return load_time_; }
+
+    /// Throughput of parsing the OFF file in the last read() in MB/s, or 0
+    /// if the mesh was loaded from its cache
+    double parse_rate() const { return parse_rate_; }
+
     /// Read mesh from an OFF file
     bool read(const std::string &_filename);
 
+    /// Load vertices, triangles, and the bounding volume hierarchy built with
+    /// \c _quality from the cache file next to the mesh file (its path plus
+    /// ".cache"), instead of reading and building them. Return false if there
+    /// is no cache file, or if it was written for a different version of the
+    /// mesh file, different build parameters, or by a different build of the
+    /// ray tracer, e.g. one with another Scalar type. The mesh file is only
+    /// hashed to compare its contents if its size matches the cache but its
+    /// modification time does not. This is a copy-based cache: the arrays
+    /// are copied out of the mapped cache file into the mesh's own vectors
+    /// (one memcpy each), and the mapping is closed afterwards.
+    bool read_cache(BVH::Quality _quality);
+
+    /// Write vertices, triangles, and the bounding volume hierarchy, which
+    /// has to be built with \c _quality, to the cache file for read_cache().
+    /// Padding bytes are written as zeros, so the same mesh always gives the
+    /// same file. Return false if the file cannot be written.
+    bool write_cache(BVH::Quality _quality) const;
+
     /// Compute normal vectors for triangles and vertices
     void compute_normals();
 
     /// Compute the axis-aligned bounding box, store minimum and maximum point in bb_min_ and bb_max_
     void compute_bounding_box();
 
+    /// Build the bounding volume hierarchy over the triangles
+    void build_bvh(BVH::Quality _quality = BVH::BINNED_SAH);
+
+    /// Expected number of triangle tests and node visits per ray hitting the
+    /// bounding box of the mesh (see BVH::expected_cost())
+    double bvh_cost() const { return bvh_.expected_cost(); }
+
     /// Does \c _ray intersect the bounding box of the mesh?
     bool intersect_bounding_box(const Ray& _ray) const;
 
@@ -95,9 +176,74 @@ public:
                             const Ray&       _ray,
                             vec3&            _intersection_point,
                             vec3&            _intersection_normal,
-                            double&          _intersection_t) const;
+                            Scalar&          _intersection_t) const;
+
+    /// Intersect a triangle with a ray without computing point and normal.
+    /// If there is an intersection, store its ray parameter \c _t and the
+    /// barycentric coordinates \c _beta and \c _gamma of the second and
+    /// third vertex.
+    bool intersect_triangle(const Triangle&  _triangle,
+                            const Ray&       _ray,
+                            Scalar&          _t,
+                            Scalar&          _beta,
+                            Scalar&          _gamma) const;
+
+    /// threshold of the triangle test for rays parallel to the triangle and
+    /// for hits at the ray origin
+    static constexpr Scalar EPSILON = Scalar(1e-8);
+
+    /// number of triangles intersect_triangles() tests at once, which is
+    /// the maximum number of triangles in a leaf of the hierarchy. The lane
+    /// count is capped by the leaf size rather than chosen for the vector
+    /// width: 8 lanes would need leaves of up to 8 triangles, which did not
+    /// render any faster in single precision.
+    static constexpr unsigned int TRIANGLE_LANES = BVH::MAX_LEAF_SIZE;
+
+    /// The triangles of a leaf of the hierarchy, with everything needed to
+    /// intersect them and nothing else: first vertex and edges, one array
+    /// per coordinate ("structure of arrays"), and the triangle indices.
+    /// Unused lanes hold degenerate triangles, which are never hit. Blocks
+    /// are aligned to cache lines, so a leaf is read as sizeof(TriangleBlock)
+    /// / 64 consecutive lines: 5 (320 bytes) with double precision and 3 (192
+    /// bytes, of which 160 are used) with RAYTRACE_FLOAT.
+    struct alignas(64) TriangleBlock
+    {
+        /// first vertex of each triangle
+        Scalar p0[3][TRIANGLE_LANES];
+        /// edge from first to second vertex
+        Scalar edge1[3][TRIANGLE_LANES];
+        /// edge from first to third vertex
+        Scalar edge2[3][TRIANGLE_LANES];
+        /// index of each triangle in Mesh::triangles_
+        unsigned int index[TRIANGLE_LANES];
+    };
+    static_assert(sizeof(TriangleBlock) == (sizeof(Scalar) == 8 ? 320 : 192),
+                  "the documented size of a triangle block");
+
+    /// Intersect \c _ray with the triangles of \c _block, all at once. Per
+    /// triangle, the result is the same as that of intersect_triangle().
+    /// \param[in] _block the triangles to intersect the ray with
+    /// \param[in] _ray the ray to intersect the triangles with
+    /// \param[out] _t ray parameter of each triangle that is hit
+    /// \return bit mask of the triangles that are hit
+    static unsigned int intersect_triangles(const TriangleBlock& _block, const Ray& _ray,
+                                            Scalar _t[TRIANGLE_LANES]);
 
 private:
+    /// Path of the mesh file
+    std::string filename_;
+
+    /// size, modification time, and hash of the file read by read(), which
+    /// identify it in the cache
+    uint64_t source_size_  = 0;
+    int64_t  source_mtime_ = 0;
+    uint64_t source_hash_  = 0;
+
+    /// time spent in the last read() or read_cache() in ms
+    double load_time_ = 0;
+    /// parse throughput of the last read() in MB/s
+    double parse_rate_ = 0;
+
     /// Does this mesh use flat or Phong shading?
     Draw_mode draw_mode_;
 
@@ -111,9 +257,39 @@ private:
     vec3 bb_min_;
     /// Maximum point of the bounding box
     vec3 bb_max_;
+
+    /// Bounding volume hierarchy over triangles_
+    BVH bvh_;
+
+    /// The triangles of each leaf of bvh_, for intersect_triangles(). This is
+    /// all the traversal touches; triangles_ and vertices_ are only needed
+    /// for the normal at the closest hit.
+    std::vector<TriangleBlock> blocks_;
+
+    /// index of the block in blocks_ of the leaf that starts at a position of
+    /// the leaf order of bvh_
+    std::vector<unsigned int> leaf_block_;
+
+    /// Use bvh_ in intersect() instead of testing all triangles?
+    bool use_bvh_ = true;
 };
 
 
+//-----------------------------------------------------------------------------
+
+
+/// read draw mode ("FLAT" or "PHONG") from stream
+inline std::istream& operator>>(std::istream& is, Mesh::Draw_mode& m)
+{
+    std::string name;
+    is >> name;
+    if      (name == "FLAT")  m = Mesh::FLAT;
+    else if (name == "PHONG") m = Mesh::PHONG;
+    else throw std::runtime_error("Invalid draw mode " + name);
+    return is;
+}
+
+
 //=============================================================================
 #endif // MESH_H defined
 //=============================================================================
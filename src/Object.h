@@ -14,6 +14,7 @@
 //== INCLUDES =================================================================
 
 #include "Ray.h"
+#include "RayPacket.h"
 #include "vec3.h"
 #include "Material.h"
 
@@ -47,7 +48,47 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const = 0;
+                           Scalar&     _intersection_t) const = 0;
+
+    /// Intersect the object with the rays of \c _packet for which \c _lanes
+    /// is true. For each of these lanes, store whether there is an
+    /// intersection in \c _hit, and if so, store point, normal and ray
+    /// parameter like intersect() does. The default implementation calls
+    /// intersect() for each lane; derived classes may trace the rays together.
+    virtual void intersect_packet(const RayPacket& _packet,
+                                  const bool        _lanes[],
+                                  bool              _hit[],
+                                  vec3              _intersection_point[],
+                                  vec3              _intersection_normal[],
+                                  Scalar            _intersection_t[]) const
+    {
+        for (int l = 0; l < RayPacket::SIZE; ++l)
+        {
+            if (_lanes[l])
+                _hit[l] = intersect(_packet.rays[l], _intersection_point[l],
+                                    _intersection_normal[l], _intersection_t[l]);
+        }
+    }
+
+    /// Is there any intersection of the object with \c _ray in front of its
+    /// origin and closer than \c _tmax? Used for shadow rays, which do not
+    /// need the closest intersection, nor its point or normal. Derived
+    /// classes should override this with something cheaper than intersect().
+    /// \param[in] _ray the ray to intersect the object with
+    /// \param[in] _tmax only intersections with ray parameter below are considered
+    virtual bool occluded(const Ray& _ray, Scalar _tmax) const
+    {
+        vec3   p, n;
+        Scalar t;
+        return intersect(_ray, p, n, t) && t < _tmax;
+    }
+
+    /// Compute the axis-aligned bounding box of the object. Return false if
+    /// the object is unbounded (e.g. a plane), in which case \c _bb_min and
+    /// \c _bb_max are not set.
+    /// \param[out] _bb_min minimum point of the bounding box
+    /// \param[out] _bb_max maximum point of the bounding box
+    virtual bool bounds(vec3& /*_bb_min*/, vec3& /*_bb_max*/) const { return false; }
 
     /// parse object properties from an input stream
     virtual void parse(std::istream &is) { throw std::logic_error("Unimplemented"); }
@@ -55,7 +96,7 @@ public:
     /// The material of this object
     Material material;
 
-    static constexpr double NO_INTERSECTION = std::numeric_limits<double>::max();
+    static constexpr Scalar NO_INTERSECTION = std::numeric_limits<Scalar>::max();
 };
 
 /// read object from stream
@@ -67,7 +108,7 @@ inline std::istream& operator>>(std::istream& is, Object& s)
 
 
 /// This typedef is for convencience only
-typedef Object* Object_ptr;
+typedef const Object* Object_ptr;
 
 
 //=============================================================================
@@ -0,0 +1,368 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "PerfCounters.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#  include <linux/perf_event.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  define HAVE_PERF_EVENTS 1
+#else
+#  define HAVE_PERF_EVENTS 0
+#endif
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+std::atomic<bool> PerfCounters::enabled_(false);
+
+
+/// names of the counters, as in the summary
+static const char* counter_names[PerfCounters::NUM_COUNTERS] = {
+    "cycles", "instructions", "cache misses", "branch misses", "task clock", "page faults", "context switches"
+};
+
+
+/// counts of a phase on one thread
+struct Phase
+{
+    /// name of the phase
+    const char* name;
+    /// counts, extrapolated if the counters were not running all the time
+    double counts[PerfCounters::NUM_COUNTERS] = {};
+    /// number of scopes
+    unsigned int calls = 0;
+};
+
+
+struct PerfCounters::Thread
+{
+    /// number of the thread, in the order of their first scopes
+    unsigned int id = 0;
+    /// file descriptor of each counter, or -1 if it is not available
+    int fds[NUM_COUNTERS];
+    /// file descriptor of the first available counter, which leads the
+    /// group of all counters, so that they are read at once, or -1
+    int leader = -1;
+    /// position of each counter in the values read from the group, or -1
+    int slot[NUM_COUNTERS];
+    /// number of counters in the group
+    int num_slots = 0;
+    /// counts of each phase, in the order of their first scopes
+    std::vector<Phase> phases;
+
+    /// Close the counters, which are of no use after the thread ended
+    void close()
+    {
+        for (int &fd : fds)
+        {
+#if HAVE_PERF_EVENTS
+            if (fd >= 0) ::close(fd);
+#endif
+            fd = -1;
+        }
+        leader = -1;
+    }
+};
+
+
+struct PerfCounters::Registry
+{
+    /// guards threads
+    std::mutex mutex;
+    /// the counters of each thread
+    std::vector<std::unique_ptr<Thread>> threads;
+};
+
+
+PerfCounters::Registry& PerfCounters::registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void PerfCounters::open_counters(Thread& _thread, int& _hardware_error, int& _software_error)
+{
+    _thread.num_slots = 0;
+    _thread.leader    = -1;
+    _hardware_error = _software_error = 0;
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+    {
+        _thread.fds[c]  = -1;
+        _thread.slot[c] = -1;
+    }
+
+#if HAVE_PERF_EVENTS
+    static const std::pair<uint32_t, uint64_t> events[NUM_COUNTERS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    };
+
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = events[c].first;
+        attr.config         = events[c].second;
+        attr.exclude_kernel = 1; // allowed with perf_event_paranoid up to 2
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // the calling thread, on any processor
+        const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, _thread.leader, 0));
+        if (fd < 0)
+        {
+            int &error = events[c].first == PERF_TYPE_HARDWARE ? _hardware_error : _software_error;
+            if (!error) error = errno;
+            continue;
+        }
+        if (_thread.leader < 0) _thread.leader = fd;
+        _thread.fds[c]  = fd;
+        _thread.slot[c] = _thread.num_slots++;
+    }
+#else
+    _hardware_error = _software_error = -1;
+#endif
+}
+
+
+/// Describe why counters could not be opened
+static std::string describe_error(int _error)
+{
+    if (_error < 0) return "perf_event_open is only available on Linux";
+    std::string message = std::strerror(_error);
+    if (_error == EACCES || _error == EPERM)
+        message += " (see /proc/sys/kernel/perf_event_paranoid)";
+    else if (_error == ENOENT || _error == EOPNOTSUPP)
+        message += " (not supported by this processor or virtual machine)";
+    return message;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool PerfCounters::enable(std::string& _message)
+{
+    // try the counters on the calling thread, the other threads open their
+    // own on their first scope
+    Thread test;
+    int hardware_error, software_error;
+    open_counters(test, hardware_error, software_error);
+    const int num_slots = test.num_slots;
+    test.close();
+
+    _message.clear();
+    if (!num_slots)
+    {
+        _message = "No performance counters: " + describe_error(hardware_error ? hardware_error : software_error);
+        return false;
+    }
+
+    if (hardware_error)
+        _message = "No hardware performance counters, counting software events only: " + describe_error(hardware_error);
+    else if (software_error)
+        _message = "No software performance counters: " + describe_error(software_error);
+
+    enabled_.store(true);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+PerfCounters::Thread& PerfCounters::thread()
+{
+    // closes the counters when the thread ends, its counts are kept
+    struct Owner
+    {
+        Thread* thread = nullptr;
+        ~Owner() { if (thread) thread->close(); }
+    };
+    thread_local Owner owner;
+
+    if (!owner.thread)
+    {
+        // threads whose counters cannot be opened count nothing
+        auto t = std::make_unique<Thread>();
+        int hardware_error, software_error;
+        open_counters(*t, hardware_error, software_error);
+
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        t->id = static_cast<unsigned int>(r.threads.size());
+        owner.thread = t.get();
+        r.threads.push_back(std::move(t));
+    }
+    return *owner.thread;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool PerfCounters::read(Sample& _sample)
+{
+    const Thread& t = thread();
+    if (!t.num_slots) return false;
+
+#if HAVE_PERF_EVENTS
+    // number of counters, times enabled and running, and the values
+    uint64_t data[3 + NUM_COUNTERS];
+    if (::read(t.leader, data, sizeof(data)) < ssize_t((3 + t.num_slots) * sizeof(uint64_t))) return false;
+
+    _sample.time_enabled = data[1];
+    _sample.time_running = data[2];
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+        _sample.values[c] = t.slot[c] >= 0 ? data[3 + t.slot[c]] : 0;
+    return true;
+#else
+    (void)_sample;
+    return false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void PerfCounters::end(const char* _phase, const Sample& _begin)
+{
+    Sample sample;
+    if (!read(sample)) return;
+
+    Thread& t = thread();
+    auto phase = t.phases.begin();
+    while (phase != t.phases.end() && std::strcmp(phase->name, _phase) != 0) ++phase;
+    if (phase == t.phases.end())
+    {
+        t.phases.push_back(Phase{_phase});
+        phase = t.phases.end() - 1;
+    }
+
+    // If the counters had to share the hardware with other counters, they
+    // only ran for part of the time. Extrapolate to the whole time.
+    const uint64_t enabled = sample.time_enabled - _begin.time_enabled;
+    const uint64_t running = sample.time_running - _begin.time_running;
+    const double scale = running > 0 && running < enabled ? double(enabled) / running : 1.0;
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+        phase->counts[c] += scale * double(sample.values[c] - _begin.values[c]);
+    ++phase->calls;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void PerfCounters::print_summary(std::ostream& _os)
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // which counters are available on all threads, and the phases in the
+    // order of their first scopes on any thread
+    bool available[NUM_COUNTERS];
+    for (int c = 0; c < NUM_COUNTERS; ++c) available[c] = true;
+    std::vector<const char*> phases;
+    for (const auto& t : r.threads)
+    {
+        if (!t->num_slots) continue;
+        for (int c = 0; c < NUM_COUNTERS; ++c) available[c] &= t->slot[c] >= 0;
+        for (const Phase& p : t->phases)
+        {
+            bool known = false;
+            for (const char* name : phases) known |= std::strcmp(name, p.name) == 0;
+            if (!known) phases.push_back(p.name);
+        }
+    }
+
+    const std::ios::fmtflags flags = _os.flags();
+    const std::streamsize precision = _os.precision();
+
+    _os << "Performance counters (task clock in ms):\n  " << std::left << std::setw(10) << "phase"
+        << std::right << std::setw(8) << "thread" << std::setw(7) << "calls";
+    for (int c = 0; c < NUM_COUNTERS; ++c)
+    {
+        _os << std::setw(c == CONTEXT_SWITCHES ? 18 : 15) << counter_names[c];
+        if (c == INSTRUCTIONS) _os << std::setw(7) << "IPC";
+    }
+    _os << "\n" << std::fixed;
+
+    // one row for a thread or the sum of all threads
+    auto print_row = [&](const char* _phase, const std::string& _thread, const Phase& _p) {
+        _os << "  " << std::left << std::setw(10) << _phase << std::right << std::setw(8) << _thread
+            << std::setw(7) << _p.calls << std::setprecision(0);
+        for (int c = 0; c < NUM_COUNTERS; ++c)
+        {
+            _os << std::setw(c == CONTEXT_SWITCHES ? 18 : 15);
+            if (!available[c])      _os << "-";
+            else if (c == TASK_CLOCK) _os << std::setprecision(3) << _p.counts[c] * 1e-6 << std::setprecision(0);
+            else                    _os << _p.counts[c];
+
+            if (c == INSTRUCTIONS)
+            {
+                _os << std::setw(7) << std::setprecision(2);
+                if (available[CYCLES] && available[INSTRUCTIONS] && _p.counts[CYCLES] > 0)
+                    _os << _p.counts[INSTRUCTIONS] / _p.counts[CYCLES];
+                else
+                    _os << "-";
+                _os << std::setprecision(0);
+            }
+        }
+        _os << "\n";
+    };
+
+    for (const char* name : phases)
+    {
+        Phase total{name};
+        unsigned int threads = 0;
+        for (const auto& t : r.threads)
+        {
+            for (const Phase& p : t->phases)
+            {
+                if (std::strcmp(p.name, name) != 0) continue;
+                print_row(name, std::to_string(t->id), p);
+                for (int c = 0; c < NUM_COUNTERS; ++c) total.counts[c] += p.counts[c];
+                total.calls += p.calls;
+                ++threads;
+            }
+        }
+        if (threads > 1) print_row(name, "all", total);
+    }
+
+    _os.flags(flags);
+    _os.precision(precision);
+    _os << std::flush;
+}
+
+
+//=============================================================================
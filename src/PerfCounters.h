@@ -0,0 +1,139 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+
+//== INCLUDES =================================================================
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class PerfCounters PerfCounters.h
+/// This class counts hardware events such as cycles, instructions, cache
+/// misses, and branch mispredictions, and software events of the kernel, per
+/// phase of the program (e.g. loading meshes or rendering) and per thread. A
+/// phase is counted by a Scope object that lives as long as the phase, on
+/// the thread that does the work, like a Profiler::Scope. The counters are
+/// read with the perf_event_open system call of Linux. Where it is not
+/// available or not permitted, e.g. on other systems, in virtual machines,
+/// or with a restrictive /proc/sys/kernel/perf_event_paranoid, enable()
+/// fails or only counts the software events, and scopes count nothing.
+class PerfCounters
+{
+public:
+
+    /// the events that are counted
+    enum Counter
+    {
+        CYCLES,           ///< processor cycles
+        INSTRUCTIONS,     ///< instructions retired
+        CACHE_MISSES,     ///< last level cache misses
+        BRANCH_MISSES,    ///< mispredicted branches
+        TASK_CLOCK,       ///< time the thread ran, in ns (software event)
+        PAGE_FAULTS,      ///< page faults (software event)
+        CONTEXT_SWITCHES, ///< context switches (software event)
+        NUM_COUNTERS
+    };
+
+    /// Start counting in scopes. Return false if no counter can be opened,
+    /// and in any case describe counters that are unavailable in \c _message.
+    static bool enable(std::string& _message);
+
+    /// Are scopes counted?
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    /// Print the counts of each phase, per thread and in total, to \c _os
+    static void print_summary(std::ostream& _os);
+
+
+    /// values of the counters at some point of a thread
+    struct Sample
+    {
+        /// values of the counters, if available
+        uint64_t values[NUM_COUNTERS] = {};
+        /// times the counters were enabled and running, to extrapolate the
+        /// counts if the counters had to share the hardware with others
+        uint64_t time_enabled = 0, time_running = 0;
+    };
+
+
+    /// \class Scope PerfCounters.h
+    /// Counts the events from its construction to its destruction on the
+    /// calling thread, for the phase named \c _phase, if counting is enabled.
+    /// The name has to stay valid until the summary is printed, e.g. a string
+    /// literal.
+    class Scope
+    {
+    public:
+        explicit Scope(const char* _phase) : phase_(enabled() ? _phase : nullptr)
+        {
+            if (phase_ && !read(begin_)) phase_ = nullptr;
+        }
+
+        ~Scope()
+        {
+            if (phase_) end(phase_, begin_);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        /// phase, or nullptr if not counted
+        const char* phase_;
+        /// counters at the beginning of the scope
+        Sample begin_;
+    };
+
+private:
+
+    /// the counters of one thread and their counts per phase
+    struct Thread;
+
+    /// the counters of all threads, which outlive the threads themselves
+    struct Registry;
+
+    /// The counters of all threads
+    static Registry& registry();
+
+    /// The counters of the calling thread, opened on first use
+    static Thread& thread();
+
+    /// Open the counters of the calling thread in \c _thread. Set the error
+    /// numbers of the first hardware and software counter that could not be
+    /// opened in \c _hardware_error and \c _software_error (0 if none, -1 if
+    /// the system has no perf_event_open).
+    static void open_counters(Thread& _thread, int& _hardware_error, int& _software_error);
+
+    /// Read the counters of the calling thread into \c _sample. Return false
+    /// if the thread has no counters.
+    static bool read(Sample& _sample);
+
+    /// Add the counts since \c _begin of the calling thread to \c _phase
+    static void end(const char* _phase, const Sample& _begin);
+
+private:
+
+    /// is counting enabled?
+    static std::atomic<bool> enabled_;
+};
+
+
+//=============================================================================
+#endif // PERF_COUNTERS_H defined
+//=============================================================================
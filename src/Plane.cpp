@@ -38,10 +38,10 @@ Plane::
 intersect(const Ray& _ray,
           vec3& _intersection_point,
           vec3& _intersection_normal,
-          double& _intersection_t) const
+          Scalar& _intersection_t) const
 /**
 {
-    const double denom = dot(normal, _ray.direction);
+    const Scalar denom = dot(normal, _ray.direction);
     // if rays are parallel this would be 0, but instead of bool here we can use double for calculation later
     if (is_close_to_zero(denom))
     {
@@ -61,10 +61,10 @@ intersect(const Ray& _ray,
     vec3 ray_direction = _ray.direction;
 
     // Calculate denom (normal dot direction)
-    double denom = dot(normal, ray_direction);
+    Scalar denom = dot(normal, ray_direction);
 
     // If denom is 0, they are parallel and there is no intersection, but we used epsilon here so if its really close to 0, it counts as 0. (floating point problem)
-    if (std::abs(denom) < std::numeric_limits<double>::epsilon()) {
+    if (std::abs(denom) < std::numeric_limits<Scalar>::epsilon()) {
         return false;
     }
 
@@ -85,4 +85,21 @@ intersect(const Ray& _ray,
     return true;
 }
 
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Plane::
+occluded(const Ray& _ray, Scalar _tmax) const
+{
+    const Scalar denom = dot(normal, _ray.direction);
+    if (std::abs(denom) < std::numeric_limits<Scalar>::epsilon()) {
+        return false;
+    }
+
+    const Scalar t = dot(normal, center - _ray.origin) / denom;
+    return t >= 0 && t < _tmax;
+}
+
 //=============================================================================
@@ -24,7 +24,7 @@
 /// This class implements a simple plane object.
 /// A plane is specified by a center point and a normal vector.
 /// This class overrides the intersection method Object::intersect().
-class Plane : public Object
+class Plane final : public Object
 {
 public:
     /// constructor
@@ -43,7 +43,11 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const override;
+                           Scalar&     _intersection_t) const override;
+
+    /// Is there an intersection of the plane with \c _ray before \c _tmax?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray, Scalar _tmax) const override;
 
     /// parse plane from an input stream
     virtual void parse(std::istream &is) override {
@@ -0,0 +1,297 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define HAVE_RDTSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#  include <intrin.h>
+#  define HAVE_RDTSC 1
+#else
+#  define HAVE_RDTSC 0
+#endif
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+std::atomic<bool> Profiler::enabled_(false);
+Profiler::Clock   Profiler::clock_ = Profiler::STEADY_CLOCK;
+
+
+/// ticks of the clock and time of the steady clock at enable(), to convert
+/// ticks to time
+static uint64_t start_ticks = 0;
+static std::chrono::steady_clock::time_point start_time;
+
+/// ticks of the clock per millisecond
+static double ticks_per_ms = 1e6;
+
+
+/// Nanoseconds of the steady clock
+static uint64_t steady_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/// Determine the ticks of the clock per millisecond, from the ticks and the
+/// time of the steady clock since enable(). The time stamp counter runs at a
+/// constant rate on current processors, which this measures.
+static void calibrate(Profiler::Clock _clock, uint64_t _ticks)
+{
+    if (_clock == Profiler::STEADY_CLOCK) return;
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    if (ms > 0) ticks_per_ms = double(_ticks - start_ticks) / ms;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+struct Profiler::Registry
+{
+    /// guards threads
+    std::mutex mutex;
+    /// the scopes of each thread
+    std::vector<std::unique_ptr<Thread>> threads;
+};
+
+
+Profiler::Registry& Profiler::registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Profiler::enable(Clock _clock)
+{
+    clock_ = HAVE_RDTSC ? _clock : STEADY_CLOCK;
+    ticks_per_ms = 1e6;
+    start_time   = std::chrono::steady_clock::now();
+    start_ticks  = now();
+    enabled_.store(true);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+uint64_t Profiler::now()
+{
+#if HAVE_RDTSC
+    if (clock_ == RDTSC) return __rdtsc();
+#endif
+    return steady_ns();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+double Profiler::to_ms(uint64_t _ticks)
+{
+    return double(int64_t(_ticks - start_ticks)) / ticks_per_ms;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Profiler::Thread& Profiler::thread()
+{
+    thread_local Thread* thread = nullptr;
+    if (!thread)
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back(std::make_unique<Thread>(Thread{static_cast<unsigned int>(r.threads.size()), {}, NO_PARENT}));
+        thread = r.threads.back().get();
+    }
+    return *thread;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int Profiler::begin(const char* _name, const std::array<unsigned int, 4>& _region)
+{
+    Thread& t = thread();
+    const unsigned int event = static_cast<unsigned int>(t.events.size());
+    t.events.push_back(Event{_name, now(), 0, t.open, {_region[0], _region[1], _region[2], _region[3]}});
+    t.open = event;
+    return event;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Profiler::end(unsigned int _event)
+{
+    Thread& t = thread();
+    t.events[_event].end = now();
+    t.open = t.events[_event].parent;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::string Profiler::path(const Thread& _thread, unsigned int _event)
+{
+    std::string p = _thread.events[_event].name;
+    for (unsigned int e = _thread.events[_event].parent; e != NO_PARENT; e = _thread.events[e].parent)
+        p = std::string(_thread.events[e].name) + "/" + p;
+    return p;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Profiler::print_summary(std::ostream& _os)
+{
+    calibrate(clock_, now());
+
+    // statistics of the scopes with the same path
+    struct Row
+    {
+        double first = 0;               // begin of the first call in ms
+        unsigned int calls = 0, threads = 0;
+        double total = 0, max = 0;      // in ms
+        unsigned int last_thread = NO_PARENT;
+    };
+    std::map<std::string, Row> rows;
+
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& t : r.threads)
+    {
+        for (unsigned int e = 0; e < t->events.size(); ++e)
+        {
+            const Event& event = t->events[e];
+            if (!event.end) continue; // still running
+
+            Row& row = rows[path(*t, e)];
+            const double begin = to_ms(event.begin), ms = to_ms(event.end) - begin;
+            if (!row.calls || begin < row.first) row.first = begin;
+            ++row.calls;
+            row.total += ms;
+            row.max = std::max(row.max, ms);
+            if (row.last_thread != t->id)
+            {
+                ++row.threads;
+                row.last_thread = t->id;
+            }
+        }
+    }
+
+    // Nested scopes follow the scope they are nested in, and scopes at the
+    // same level are in the order of their first calls: sort by the first
+    // calls of each scope on the path.
+    std::vector<std::pair<std::vector<double>, std::string>> sorted;
+    for (const auto& [name, row] : rows)
+    {
+        std::vector<double> key;
+        for (size_t slash = name.find('/'); slash != std::string::npos; slash = name.find('/', slash + 1))
+        {
+            const auto parent = rows.find(name.substr(0, slash));
+            key.push_back(parent != rows.end() ? parent->second.first : 0.0);
+        }
+        key.push_back(row.first);
+        sorted.emplace_back(key, name);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    _os << "Profile (" << (clock_ == RDTSC ? "time stamp counter" : "steady clock") << ", "
+        << r.threads.size() << (r.threads.size() == 1 ? " thread" : " threads") << "):\n";
+    _os << "  " << std::left << std::setw(32) << "scope" << std::right
+        << std::setw(8) << "calls" << std::setw(9) << "threads" << std::setw(12) << "total ms"
+        << std::setw(12) << "mean ms" << std::setw(12) << "max ms" << "\n";
+
+    const std::ios::fmtflags flags = _os.flags();
+    const std::streamsize precision = _os.precision();
+    _os << std::fixed << std::setprecision(3);
+    for (const auto& [key, name] : sorted)
+    {
+        const Row& row = rows[name];
+        // nested scopes are indented below their parents
+        const size_t slash = name.rfind('/');
+        const size_t depth = std::count(name.begin(), name.end(), '/');
+        const std::string label = std::string(2 * depth, ' ') + name.substr(slash == std::string::npos ? 0 : slash + 1);
+        _os << "  " << std::left << std::setw(32) << label << std::right
+            << std::setw(8) << row.calls << std::setw(9) << row.threads << std::setw(12) << row.total
+            << std::setw(12) << row.total / row.calls << std::setw(12) << row.max << "\n";
+    }
+    _os.flags(flags);
+    _os.precision(precision);
+    _os << std::flush;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Profiler::write_trace(const std::string& _filename)
+{
+    calibrate(clock_, now());
+
+    std::ofstream ofs(_filename);
+    if (!ofs) return false;
+
+    // complete events ("X") with times in microseconds, and the names of the
+    // threads as metadata ("M")
+    ofs << std::fixed << std::setprecision(3);
+    ofs << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& t : r.threads)
+    {
+        ofs << (first ? "" : ",") << "\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << t->id
+            << ", \"args\": {\"name\": \"thread " << t->id << "\"}}";
+        first = false;
+        for (const Event& event : t->events)
+        {
+            if (!event.end) continue;
+            ofs << ",\n  {\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << t->id
+                << ", \"ts\": " << 1000.0 * to_ms(event.begin)
+                << ", \"dur\": " << 1000.0 * (to_ms(event.end) - to_ms(event.begin));
+            if (event.region[2])
+                ofs << ", \"args\": {\"x\": " << event.region[0] << ", \"y\": " << event.region[1]
+                    << ", \"width\": " << event.region[2] << ", \"height\": " << event.region[3] << "}";
+            ofs << "}";
+        }
+    }
+    ofs << "\n]}\n";
+    return bool(ofs);
+}
+
+
+//=============================================================================
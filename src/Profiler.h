@@ -0,0 +1,196 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+
+//== INCLUDES =================================================================
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Profiler Profiler.h
+/// This class records how long named phases of the program take, such as
+/// loading a scene, parsing a mesh, or rendering. A phase is timed by a
+/// Scope object that lives as long as the phase, and scopes may be nested.
+/// Each thread records its scopes on its own, so scopes need no
+/// synchronization. Nothing is recorded until the profiler is enabled, and
+/// the recorded scopes can be summarized in a table (print_summary()) or
+/// written as a trace to view in a browser (write_trace()).
+class Profiler
+{
+public:
+
+    /// This type is used to choose the clock that times the scopes: the
+    /// monotonic std::chrono::steady_clock, or the time stamp counter of x86
+    /// processors (cheaper to read, converted to time with the steady clock).
+    enum Clock {STEADY_CLOCK, RDTSC};
+
+    /// Start recording scopes, timed by \c _clock. Machines without a time
+    /// stamp counter use the steady clock instead.
+    static void enable(Clock _clock = STEADY_CLOCK);
+
+    /// Are scopes recorded?
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    /// The clock that times the scopes
+    static Clock clock() { return clock_; }
+
+    /// Print the number of calls, and the total, mean, and maximum time of
+    /// each scope to \c _os. Scopes are identified by their names and those
+    /// of the scopes they are nested in, in the same thread.
+    static void print_summary(std::ostream& _os);
+
+    /// Write all recorded scopes in the trace event format of Chrome, which
+    /// can be viewed with chrome://tracing or https://ui.perfetto.dev, with
+    /// a row for each thread. Return whether the file could be written.
+    static bool write_trace(const std::string& _filename);
+
+
+    /// \class Scope Profiler.h
+    /// Records the time from its construction to its destruction as a scope
+    /// named \c _name, if the profiler is enabled. The name has to stay valid
+    /// until the profile is printed or written, e.g. a string literal.
+    class Scope
+    {
+    public:
+        explicit Scope(const char* _name) : name_(enabled() ? _name : nullptr)
+        {
+            if (name_) event_ = begin(name_);
+        }
+
+        /// Scope that works on the region of the image with upper left
+        /// corner (\c _x, \c _y) and size \c _width x \c _height, such as a
+        /// tile. The trace shows the region with the scope.
+        Scope(const char* _name, unsigned int _x, unsigned int _y, unsigned int _width, unsigned int _height)
+        : name_(enabled() ? _name : nullptr)
+        {
+            if (name_) event_ = begin(name_, {_x, _y, _width, _height});
+        }
+
+        ~Scope()
+        {
+            if (name_) end(event_);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        /// name, or nullptr if not recorded
+        const char* name_;
+        /// index of the scope among those of its thread
+        unsigned int event_ = 0;
+    };
+
+private:
+
+    /// a recorded scope
+    struct Event
+    {
+        /// name of the scope
+        const char* name;
+        /// ticks of the clock at the beginning and end of the scope
+        uint64_t begin, end;
+        /// index of the enclosing scope of the same thread, or NO_PARENT
+        unsigned int parent;
+        /// x, y, width, and height of the region of the image, if any
+        unsigned int region[4];
+    };
+
+    /// the scopes recorded by one thread
+    struct Thread
+    {
+        /// number of the thread, in the order of their first scopes
+        unsigned int id;
+        /// the scopes, in the order they began
+        std::vector<Event> events;
+        /// the innermost scope that has not ended, or NO_PARENT
+        unsigned int open;
+    };
+
+    /// the scopes of all threads, which outlive the threads themselves
+    struct Registry;
+
+    /// parent of scopes that are not nested in another one
+    static constexpr unsigned int NO_PARENT = ~0u;
+
+    /// The scopes of all threads
+    static Registry& registry();
+
+    /// Start a scope named \c _name, working on \c _region of the image if
+    /// it is not empty, in the calling thread, and return its index
+    static unsigned int begin(const char* _name, const std::array<unsigned int, 4>& _region = {});
+
+    /// End the scope with index \c _event of the calling thread
+    static void end(unsigned int _event);
+
+    /// The scopes of the calling thread
+    static Thread& thread();
+
+    /// Current ticks of the clock
+    static uint64_t now();
+
+    /// Milliseconds since enable() at \c _ticks of the clock
+    static double to_ms(uint64_t _ticks);
+
+    /// Path of the names of scope \c _event of \c _thread and the scopes it
+    /// is nested in, separated by '/'
+    static std::string path(const Thread& _thread, unsigned int _event);
+
+private:
+
+    /// is the profiler enabled?
+    static std::atomic<bool> enabled_;
+
+    /// clock that times the scopes
+    static Clock clock_;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// read profiler clock ("steady" or "rdtsc") from stream
+inline std::istream& operator>>(std::istream& is, Profiler::Clock& c)
+{
+    std::string name;
+    is >> name;
+    if      (name == "steady") c = Profiler::STEADY_CLOCK;
+    else if (name == "rdtsc")  c = Profiler::RDTSC;
+    else throw std::runtime_error("Invalid profiler clock " + name);
+    return is;
+}
+
+/// output profiler clock
+inline std::ostream& operator<<(std::ostream& os, Profiler::Clock c)
+{
+    switch (c)
+    {
+        case Profiler::STEADY_CLOCK: os << "steady"; break;
+        case Profiler::RDTSC:        os << "rdtsc";  break;
+    }
+    return os;
+}
+
+
+//=============================================================================
+#endif // PROFILER_H defined
+//=============================================================================
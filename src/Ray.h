@@ -16,6 +16,8 @@
 
 #include "vec3.h"
 
+#include <limits>
+
 
 //== CLASS DEFINITION =========================================================
 
@@ -38,7 +40,7 @@ public:
 
     /// Compute the point on the ray at the parameter \c _t, which is
     /// origin + _t*direction.
-    vec3 operator()(double _t) const
+    vec3 operator()(Scalar _t) const
     {
         return origin + _t*direction;
     }
@@ -56,6 +58,22 @@ public:
 //-----------------------------------------------------------------------------
 
 
+/// Origin of a secondary ray leaving a surface at \c _point with normal
+/// \c _normal: the point moved along the normal by a small offset, so that
+/// the ray does not hit the surface it starts from because of rounding
+/// errors. The offset is 0.001, or larger for points so far from the origin
+/// that their rounding error exceeds that, which matters for float Scalars.
+inline vec3 offset_origin(const vec3& _point, const vec3& _normal)
+{
+    const Scalar scale  = std::max(std::abs(_point[0]), std::max(std::abs(_point[1]), std::abs(_point[2])));
+    const Scalar offset = std::max(Scalar(0.001), 256 * std::numeric_limits<Scalar>::epsilon() * scale);
+    return _point + _normal * offset;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 /// read ray from stream
 inline std::istream& operator>>(std::istream& is, Ray& r)
 {
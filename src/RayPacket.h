@@ -0,0 +1,69 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class RayPacket RayPacket.h
+/// A packet of coherent rays, e.g. the primary rays of a block of
+/// RayPacket::WIDTH x RayPacket::HEIGHT pixels, that are traced together.
+/// Besides the individual rays, the packet stores origins, directions and
+/// inverse directions as one array per coordinate ("structure of arrays"),
+/// so that loops over the lanes of the packet can be vectorized.
+/// Lanes that do not hold a ray (e.g. at the image border) are inactive.
+struct RayPacket
+{
+    /// number of pixel columns covered by a packet
+    static constexpr int WIDTH  = 2;
+    /// number of pixel rows covered by a packet
+    static constexpr int HEIGHT = 2;
+    /// number of rays (lanes) in a packet
+    static constexpr int SIZE   = WIDTH * HEIGHT;
+
+    /// Set lane \c _lane to \c _ray and mark it active.
+    void set(int _lane, const Ray& _ray)
+    {
+        rays[_lane]   = _ray;
+        active[_lane] = true;
+        for (int i = 0; i < 3; ++i)
+        {
+            origin[i][_lane]        = _ray.origin[i];
+            direction[i][_lane]     = _ray.direction[i];
+            inv_direction[i][_lane] = Scalar(1) / _ray.direction[i];
+        }
+    }
+
+    /// the rays of the lanes
+    Ray rays[SIZE];
+
+    /// which lanes hold a ray?
+    bool active[SIZE] = {};
+
+    /// ray origins, origin[i][lane] is coordinate i of lane's ray
+    Scalar origin[3][SIZE] = {};
+    /// ray directions
+    Scalar direction[3][SIZE] = {};
+    /// component-wise inverse of the ray directions
+    Scalar inv_direction[3][SIZE] = {};
+};
+
+
+//=============================================================================
+#endif // RAYPACKET_H defined
+//=============================================================================
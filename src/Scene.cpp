@@ -11,15 +11,14 @@
 //== INCLUDES =================================================================
 #include "Scene.h"
 
-#include "Plane.h"
-#include "Sphere.h"
-#include "Cylinder.h"
-#include "Mesh.h"
+#include "ThreadPool.h"
 
 #include <limits>
+#include <cmath>
 #include <map>
 #include <functional>
 #include <stdexcept>
+#include <chrono>
 
 #if HAVE_OPENMP
 #  include <omp.h>
@@ -27,41 +26,183 @@
 
 //-----------------------------------------------------------------------------
 
+template <class Function>
+auto Scene::withBoundedObject(unsigned int _i, Function&& _f) const
+{
+    // same order as in forEachObject()
+    size_t i = _i;
+    if (i < spheres.size()) return _f(spheres[i]);
+    i -= spheres.size();
+    if (i < cylinders.size()) return _f(cylinders[i]);
+    i -= cylinders.size();
+    if (i < meshes.size()) return _f(meshes[i]);
+    return _f(instances[i - meshes.size()]);
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Function>
+bool Scene::forEachObject(Function&& _f) const
+{
+    for (const Sphere &o: spheres) if (_f(o)) return true;
+    return forEachNonSphere(_f);
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Function>
+bool Scene::forEachNonSphere(Function&& _f) const
+{
+    for (const Cylinder &o: cylinders) if (_f(o)) return true;
+    for (const Mesh     &o: meshes)    if (_f(o)) return true;
+    for (const Instance &o: instances) if (_f(o)) return true;
+    for (const Plane    &o: planes)    if (_f(o)) return true;
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
 
 Image Scene::render()
 {
+    Profiler::Scope scope("render");
+
     // allocate new image.
     Image img(camera.width, camera.height);
 
-    // Function rendering a full column of the image
-    auto raytraceColumn = [&img, this](int x) {
-        for (int y=0; y<int(camera.height); ++y)
+    // split the image into tiles, which are the work items for the threads
+    tiles = make_tiles(camera.width, camera.height, tileSize, tileOrder);
+
+    // cost of the work done by the calling thread so far, such that the
+    // difference before and after a pixel is its cost in the heatmap
+    const auto renderStart = std::chrono::steady_clock::now();
+    auto cost = [this, renderStart]() -> double {
+        const Statistics& stats = Statistics::local();
+        switch (heatmapCost)
         {
-            Ray ray = camera.primary_ray(x,y);
+            case TIME:  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - renderStart).count();
+            case RAYS:  return double(stats.rays());
+            case BOXES: return double(stats[Statistics::BOX_TESTS]);
+            case TESTS: return double(stats.tests());
+            default:    return 0.0;
+        }
+    };
+    heatmap.assign(heatmapCost == NO_COST ? 0 : size_t(camera.width) * camera.height, 0.0);
 
-            // compute color by tracing this ray
-            vec3 color = trace(ray, 0);
+    // counts of each tile, merged after rendering
+    std::vector<Statistics> tileStatistics(tiles.size());
 
-            // avoid over-saturation
-            color = min(color, vec3(1, 1, 1));
+    // Function rendering one tile of the image
+    auto raytraceTile = [&img, &cost, &tileStatistics, this](Tile& tile) {
+        Profiler::Scope scope("tile", tile.x0, tile.y0, tile.x1 - tile.x0, tile.y1 - tile.y0);
+        PerfCounters::Scope counters("render");
+        StopWatch timer;
+        timer.start();
+        const Statistics statisticsBefore = Statistics::local();
+
+        if (usePackets)
+        {
+            for (unsigned int y=tile.y0; y<tile.y1; y+=RayPacket::HEIGHT)
+            {
+                for (unsigned int x=tile.x0; x<tile.x1; x+=RayPacket::WIDTH)
+                {
+                    // rays of a block of pixels, clipped to the tile
+                    RayPacket packet;
+                    camera.primary_rays(x, y, tile.x1, tile.y1, packet);
+
+                    int numRays = 0;
+                    for (int l=0; l<RayPacket::SIZE; ++l) numRays += packet.active[l];
+                    Statistics::count(Statistics::PRIMARY_RAYS, numRays);
+
+                    // compute colors by tracing the rays together
+                    const double costBefore = heatmapCost == NO_COST ? 0.0 : cost();
+                    vec3 colors[RayPacket::SIZE];
+                    trace(packet, colors);
+                    const double pixelCost = heatmapCost == NO_COST ? 0.0 : (cost() - costBefore) / numRays;
+
+                    for (int l=0; l<RayPacket::SIZE; ++l)
+                    {
+                        if (!packet.active[l]) continue;
+
+                        // avoid over-saturation and store pixel color
+                        const unsigned int px = x + l % RayPacket::WIDTH, py = y + l / RayPacket::WIDTH;
+                        img(px, py) = min(colors[l], vec3(1, 1, 1));
+                        if (heatmapCost != NO_COST) heatmap[size_t(py) * camera.width + px] = pixelCost;
+                    }
+                }
+            }
 
-            // store pixel color
-            img(x,y) = color;
+            tile.time = timer.stop();
+            tileStatistics[&tile - tiles.data()] = Statistics::local() - statisticsBefore;
+            return;
         }
+
+        for (unsigned int y=tile.y0; y<tile.y1; ++y)
+        {
+            for (unsigned int x=tile.x0; x<tile.x1; ++x)
+            {
+                Ray ray = camera.primary_ray(x,y);
+                Statistics::count(Statistics::PRIMARY_RAYS);
+
+                // compute color by tracing this ray
+                const double costBefore = heatmapCost == NO_COST ? 0.0 : cost();
+                vec3 color = trace(ray, 0);
+                if (heatmapCost != NO_COST) heatmap[size_t(y) * camera.width + x] = cost() - costBefore;
+
+                // avoid over-saturation
+                color = min(color, vec3(1, 1, 1));
+
+                // store pixel color
+                img(x,y) = color;
+            }
+        }
+
+        tile.time = timer.stop();
+        tileStatistics[&tile - tiles.data()] = Statistics::local() - statisticsBefore;
     };
 
-    // If possible, raytrace image columns in parallel.
+    // If possible, raytrace tiles in parallel. Threads fetch the next tile
+    // as soon as they are done, so expensive tiles do not stall the others.
 
-#if HAVE_OPENMP
-    std::cout << "Rendering with up to " << omp_get_max_threads() << " threads." << std::endl;
-#  pragma omp parallel for
-#else
-    std::cout << "Rendering singlethreaded (compiled without OpenMP)." << std::endl;
+    Backend backend = renderBackend;
+#if !HAVE_OPENMP
+    if (backend == OPENMP)
+    {
+        std::cout << "Compiled without OpenMP, using the thread pool instead." << std::endl;
+        backend = THREAD_POOL;
+    }
 #endif
 
-    for (int x=0; x<int(camera.width); ++x) {
-        raytraceColumn(x);
+    if (backend == THREAD_POOL)
+    {
+        ThreadPool pool(numThreads);
+        std::cout << "Rendering with " << pool.num_threads() << " threads (thread pool)." << std::endl;
+        pool.parallel_for(tiles.size(), [&](unsigned int i, unsigned int) {
+            raytraceTile(tiles[i]);
+        });
     }
+#if HAVE_OPENMP
+    else if (backend == OPENMP)
+    {
+        const int threads = numThreads ? int(numThreads) : omp_get_max_threads();
+        std::cout << "Rendering with up to " << threads << " threads (OpenMP)." << std::endl;
+#       pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (int i=0; i<int(tiles.size()); ++i) {
+            raytraceTile(tiles[i]);
+        }
+    }
+#endif
+    else
+    {
+        std::cout << "Rendering singlethreaded." << std::endl;
+        for (Tile &tile : tiles) {
+            raytraceTile(tile);
+        }
+    }
+
+    statistics = Statistics();
+    for (const Statistics &s : tileStatistics)
+        statistics += s;
 
     // Note: compiler will elide copy.
     return img;
@@ -79,23 +220,60 @@ vec3 Scene::trace(const Ray& _ray, int _depth)
     Object_ptr  object;
     vec3        point;
     vec3        normal;
-    double      t;
+    Scalar      t;
     if (!intersect(_ray, object, point, normal, t))
     {
         return background;
     }
+    Statistics::count(Statistics::HITS);
+
+    return shade(_ray, object, point, normal, _depth);
+}
+
+
+//-----------------------------------------------------------------------------
+
+void Scene::trace(const RayPacket& _packet, vec3 _colors[])
+{
+    // same as trace() for depth 0
+    if (0 > max_depth)
+    {
+        for (int l = 0; l < RayPacket::SIZE; ++l) _colors[l] = vec3(0, 0, 0);
+        return;
+    }
+
+    bool        hit[RayPacket::SIZE];
+    Object_ptr  objects[RayPacket::SIZE];
+    vec3        points[RayPacket::SIZE];
+    vec3        normals[RayPacket::SIZE];
+    Scalar      t[RayPacket::SIZE];
+    intersect(_packet, hit, objects, points, normals, t);
+
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        if (_packet.active[l] && hit[l]) Statistics::count(Statistics::HITS);
+        if (_packet.active[l])
+            _colors[l] = hit[l] ? shade(_packet.rays[l], objects[l], points[l], normals[l], 0) : background;
+    }
+}
 
+
+//-----------------------------------------------------------------------------
+
+vec3 Scene::shade(const Ray& _ray, Object_ptr _object, const vec3& _point, const vec3& _normal, int _depth)
+{
     // compute local Phong lighting (ambient+diffuse+specular)
-    vec3 color = lighting(point, normal, -_ray.direction, object->material);
+    vec3 color = lighting(_point, _normal, -_ray.direction, _object->material);
 
     // Compute reflections by recursive ray tracing
-    if (object->material.mirror && _depth < max_depth)
+    if (_object->material.mirror && _depth < max_depth)
     {
-        vec3 reflectionDir = reflect(_ray.direction, normal);
-        Ray reflectionRay(point + normal * 0.001, reflectionDir); // small offset to avoid self-intersection
+        vec3 reflectionDir = reflect(_ray.direction, _normal);
+        Ray reflectionRay(offset_origin(_point, _normal), reflectionDir); // small offset to avoid self-intersection
+        Statistics::count(Statistics::REFLECTION_RAYS);
         vec3 reflectionColor = trace(reflectionRay, _depth + 1);
         // Linear interpolation
-        color = (1 - object->material.mirror) * color + object->material.mirror * reflectionColor;
+        color = (1 - _object->material.mirror) * color + _object->material.mirror * reflectionColor;
     }
 
     return color;
@@ -104,29 +282,365 @@ vec3 Scene::trace(const Ray& _ray, int _depth)
 
 //-----------------------------------------------------------------------------
 
-bool Scene::intersect(const Ray& _ray, Object_ptr& _object, vec3& _point, vec3& _normal, double& _t)
+bool Scene::intersect(const Ray& _ray, Object_ptr& _object, vec3& _point, vec3& _normal, Scalar& _t)
 {
-    double  t, tmin(Object::NO_INTERSECTION);
+    Scalar  t, tmin(Object::NO_INTERSECTION);
     vec3    p, n;
 
-    for (const auto &o: objects) // for each object
+    // Spheres tested in blocks only provide their ray parameter, so point
+    // and normal are computed at the end, if a sphere is the closest object.
+    const Sphere* closestSphere = nullptr;
+
+    if (useBVH)
     {
-        if (o->intersect(_ray, p, n, t)) // does ray intersect object?
+        // bounded objects: only those whose boxes are hit, front to back.
+        // Equally close hits are resolved like in the linear search below.
+        unsigned int closest = 0;
+        auto intersectObject = [&](unsigned int i, Scalar& tmax) {
+            Statistics::count(Statistics::OBJECT_TESTS);
+            return withBoundedObject(i, [&](const auto &o) {
+                if (o.intersect(_ray, p, n, t) && (t < tmax || (t == tmax && i < closest)))
+                {
+                    tmax = t;
+                    closest = i;
+                    closestSphere = nullptr;
+                    _object = &o;
+                    _point  = p;
+                    _normal = n;
+                    _t      = t;
+                    return true;
+                }
+                return false;
+            });
+        };
+
+        if (useGrid)
+        {
+            grid.intersect(_ray, tmin, intersectObject);
+        }
+        else
         {
-            if (t < tmin) // is intersection point the currently closest one?
+            // the spheres of a leaf are tested together, the other objects
+            // one by one
+            bvh.intersect_leaves(_ray, tmin, [&](unsigned int first, unsigned int count, Scalar& tmax) {
+                const unsigned int block = leafSphereBlock[first];
+                if (block == NO_SPHERE_BLOCK)
+                {
+                    bool accepted = false;
+                    for (unsigned int l = 0; l < count; ++l)
+                        accepted |= intersectObject(bvh.primitive(first + l), tmax);
+                    return accepted;
+                }
+
+                const Sphere::SphereBlock &spheresOfLeaf = leafSphereBlocks[block];
+                Scalar ts[Sphere::SPHERE_LANES];
+                const unsigned int mask = Sphere::intersect_spheres(spheresOfLeaf, _ray, ts);
+                bool accepted = false;
+                for (unsigned int l = 0; l < count; ++l)
+                {
+                    const unsigned int i = spheresOfLeaf.index[l];
+                    if (i >= spheres.size())
+                    {
+                        accepted |= intersectObject(i, tmax);
+                        continue;
+                    }
+                    Statistics::count(Statistics::OBJECT_TESTS);
+                    if ((mask >> l & 1) && (ts[l] < tmax || (ts[l] == tmax && i < closest)))
+                    {
+                        tmax = ts[l];
+                        closest = i;
+                        closestSphere = &spheres[i];
+                        accepted = true;
+                    }
+                }
+                return accepted;
+            });
+        }
+
+        // unbounded objects have to be tested for every ray
+        Statistics::count(Statistics::OBJECT_TESTS, planes.size());
+        for (const Plane &o: planes)
+        {
+            if (o.intersect(_ray, p, n, t) && t < tmin)
             {
                 tmin = t;
-                _object = o.get();
+                closestSphere = nullptr;
+                _object = &o;
                 _point  = p;
                 _normal = n;
                 _t      = t;
             }
         }
     }
+    else
+    {
+        // spheres in blocks, in their order
+        for (const Sphere::SphereBlock &block: sphereBlocks)
+        {
+            Scalar ts[Sphere::SPHERE_LANES];
+            const unsigned int mask = Sphere::intersect_spheres(block, _ray, ts);
+            for (unsigned int l = 0; l < Sphere::SPHERE_LANES; ++l)
+            {
+                if (block.index[l] < spheres.size()) Statistics::count(Statistics::OBJECT_TESTS);
+                if ((mask >> l & 1) && block.index[l] < spheres.size() && ts[l] < tmin)
+                {
+                    tmin = ts[l];
+                    closestSphere = &spheres[block.index[l]];
+                }
+            }
+        }
+
+        forEachNonSphere([&](const auto &o) {
+            Statistics::count(Statistics::OBJECT_TESTS);
+            if (o.intersect(_ray, p, n, t)) // does ray intersect object?
+            {
+                if (t < tmin) // is intersection point the currently closest one?
+                {
+                    tmin = t;
+                    closestSphere = nullptr;
+                    _object = &o;
+                    _point  = p;
+                    _normal = n;
+                    _t      = t;
+                }
+            }
+            return false;
+        });
+    }
+
+    if (closestSphere)
+    {
+        closestSphere->intersect(_ray, _point, _normal, _t);
+        _object = closestSphere;
+    }
 
     return (tmin != Object::NO_INTERSECTION);
 }
 
+void Scene::intersect(const RayPacket& _packet, bool _hit[], Object_ptr _objects[],
+                      vec3 _points[], vec3 _normals[], Scalar _t[])
+{
+    // per lane results of a single object
+    bool    h[RayPacket::SIZE];
+    vec3    p[RayPacket::SIZE], n[RayPacket::SIZE];
+    Scalar  t[RayPacket::SIZE], tmin[RayPacket::SIZE];
+
+    // per lane closest sphere, if it was tested in a block, see intersect()
+    const Sphere* closestSphere[RayPacket::SIZE] = {};
+
+    bool lanes[RayPacket::SIZE];
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        lanes[l] = _packet.active[l];
+        tmin[l]  = Object::NO_INTERSECTION;
+    }
+
+    // count the tests of an object against the rays of _lanes
+    auto countTests = [](const bool* _lanes) {
+        for (int l = 0; l < RayPacket::SIZE; ++l)
+            if (_lanes[l]) Statistics::count(Statistics::OBJECT_TESTS);
+    };
+
+    // keep the hits of an object that are closer than those found so far
+    auto update = [&](Object_ptr _o, const bool* _lanes, Scalar* _tmax) {
+        for (int l = 0; l < RayPacket::SIZE; ++l)
+        {
+            if (_lanes[l] && h[l] && t[l] < _tmax[l])
+            {
+                _tmax[l]         = t[l];
+                closestSphere[l] = nullptr;
+                _objects[l]      = _o;
+                _points[l]       = p[l];
+                _normals[l]      = n[l];
+                _t[l]            = t[l];
+            }
+        }
+    };
+
+    if (useBVH)
+    {
+        // bounded objects: equally close hits are resolved like in intersect()
+        unsigned int closest[RayPacket::SIZE] = {};
+        auto intersectObject = [&](unsigned int i, const bool* active, Scalar* tmax) {
+            countTests(active);
+            Object_ptr o = withBoundedObject(i, [&](const auto &o) {
+                o.intersect_packet(_packet, active, h, p, n, t);
+                return static_cast<Object_ptr>(&o);
+            });
+            for (int l = 0; l < RayPacket::SIZE; ++l)
+            {
+                if (active[l] && h[l] && (t[l] < tmax[l] || (t[l] == tmax[l] && i < closest[l])))
+                {
+                    tmax[l]          = t[l];
+                    closest[l]       = i;
+                    closestSphere[l] = nullptr;
+                    _objects[l]      = o;
+                    _points[l]       = p[l];
+                    _normals[l]      = n[l];
+                    _t[l]            = t[l];
+                }
+            }
+        };
+
+        if (useGrid)
+        {
+            grid.intersect(_packet, lanes, tmin, intersectObject);
+        }
+        else
+        {
+            // The spheres of a leaf are tested together for each ray, the
+            // other objects for all rays together. The closest hit does not
+            // depend on the order of the tests.
+            bvh.intersect_leaves(_packet, lanes, tmin,
+                                 [&](unsigned int first, unsigned int count, const bool* active, Scalar* tmax) {
+                const unsigned int block = leafSphereBlock[first];
+                if (block == NO_SPHERE_BLOCK)
+                {
+                    for (unsigned int j = 0; j < count; ++j)
+                        intersectObject(bvh.primitive(first + j), active, tmax);
+                    return;
+                }
+
+                const Sphere::SphereBlock &spheresOfLeaf = leafSphereBlocks[block];
+                Scalar ts[Sphere::SPHERE_LANES];
+                for (int l = 0; l < RayPacket::SIZE; ++l)
+                {
+                    if (!active[l]) continue;
+                    const unsigned int mask = Sphere::intersect_spheres(spheresOfLeaf, _packet.rays[l], ts);
+                    for (unsigned int j = 0; j < count; ++j)
+                    {
+                        const unsigned int i = spheresOfLeaf.index[j];
+                        if (i < spheres.size()) Statistics::count(Statistics::OBJECT_TESTS);
+                        if (i < spheres.size() && (mask >> j & 1) &&
+                            (ts[j] < tmax[l] || (ts[j] == tmax[l] && i < closest[l])))
+                        {
+                            tmax[l]          = ts[j];
+                            closest[l]       = i;
+                            closestSphere[l] = &spheres[i];
+                        }
+                    }
+                }
+
+                for (unsigned int j = 0; j < count; ++j)
+                {
+                    if (spheresOfLeaf.index[j] >= spheres.size())
+                        intersectObject(spheresOfLeaf.index[j], active, tmax);
+                }
+            });
+        }
+
+        // unbounded objects have to be tested for every ray
+        for (const Plane &o: planes)
+        {
+            countTests(lanes);
+            o.intersect_packet(_packet, lanes, h, p, n, t);
+            update(&o, lanes, tmin);
+        }
+    }
+    else
+    {
+        // spheres in blocks, in their order, for each ray
+        Scalar ts[Sphere::SPHERE_LANES];
+        for (const Sphere::SphereBlock &block: sphereBlocks)
+        {
+            for (int l = 0; l < RayPacket::SIZE; ++l)
+            {
+                if (!lanes[l]) continue;
+                const unsigned int mask = Sphere::intersect_spheres(block, _packet.rays[l], ts);
+                for (unsigned int j = 0; j < Sphere::SPHERE_LANES; ++j)
+                {
+                    if (block.index[j] < spheres.size()) Statistics::count(Statistics::OBJECT_TESTS);
+                    if ((mask >> j & 1) && block.index[j] < spheres.size() && ts[j] < tmin[l])
+                    {
+                        tmin[l]          = ts[j];
+                        closestSphere[l] = &spheres[block.index[j]];
+                    }
+                }
+            }
+        }
+
+        forEachNonSphere([&](const auto &o) {
+            countTests(lanes);
+            o.intersect_packet(_packet, lanes, h, p, n, t);
+            update(&o, lanes, tmin);
+            return false;
+        });
+    }
+
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        if (closestSphere[l])
+        {
+            closestSphere[l]->intersect(_packet.rays[l], _points[l], _normals[l], _t[l]);
+            _objects[l] = closestSphere[l];
+        }
+        _hit[l] = lanes[l] && tmin[l] != Object::NO_INTERSECTION;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+bool Scene::occluded(const Ray& _ray, Scalar _tmax) const
+{
+    // the spheres of a block are hit before _tmax if their closest hit is
+    auto occludedSpheres = [&](const Sphere::SphereBlock &block, unsigned int count) {
+        Scalar ts[Sphere::SPHERE_LANES];
+        const unsigned int mask = Sphere::intersect_spheres(block, _ray, ts);
+        for (unsigned int l = 0; l < count; ++l)
+        {
+            if (block.index[l] < spheres.size()) Statistics::count(Statistics::OBJECT_TESTS);
+            if ((mask >> l & 1) && block.index[l] < spheres.size() && ts[l] < _tmax) return true;
+        }
+        return false;
+    };
+
+    if (useBVH)
+    {
+        for (const Plane &o: planes)
+        {
+            Statistics::count(Statistics::OBJECT_TESTS);
+            if (o.occluded(_ray, _tmax)) return true;
+        }
+
+        auto occludedObject = [&](unsigned int i) {
+            Statistics::count(Statistics::OBJECT_TESTS);
+            return withBoundedObject(i, [&](const auto &o) { return o.occluded(_ray, _tmax); });
+        };
+        if (useGrid) return grid.occluded(_ray, _tmax, occludedObject);
+
+        return bvh.occluded_leaves(_ray, _tmax, [&](unsigned int first, unsigned int count) {
+            const unsigned int block = leafSphereBlock[first];
+            if (block == NO_SPHERE_BLOCK)
+            {
+                for (unsigned int l = 0; l < count; ++l)
+                    if (occludedObject(bvh.primitive(first + l))) return true;
+                return false;
+            }
+
+            const Sphere::SphereBlock &spheresOfLeaf = leafSphereBlocks[block];
+            if (occludedSpheres(spheresOfLeaf, count)) return true;
+            for (unsigned int l = 0; l < count; ++l)
+            {
+                if (spheresOfLeaf.index[l] >= spheres.size() && occludedObject(spheresOfLeaf.index[l]))
+                    return true;
+            }
+            return false;
+        });
+    }
+
+    for (const Sphere::SphereBlock &block: sphereBlocks)
+    {
+        if (occludedSpheres(block, Sphere::SPHERE_LANES)) return true;
+    }
+    return forEachNonSphere([&](const auto &o) {
+        Statistics::count(Statistics::OBJECT_TESTS);
+        return o.occluded(_ray, _tmax);
+    });
+}
+
+//-----------------------------------------------------------------------------
+
 vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view, const Material& _material)
 {
     vec3 ambient_contribution  = _material.ambient*ambience;
@@ -135,20 +649,20 @@ vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view,
     for (const Light& lightsource : lights)
     {
         vec3 l = normalize(lightsource.position - _point);
-        Ray shadowRay(_point + _normal * 0.001, l); // small offset to avoid self-intersection
-        Object_ptr shadowObject;
-        vec3 shadowIntersectionPoint, shadowIntersectionNormal;
-        double shadowIntersectionT;
+        Ray shadowRay(offset_origin(_point, _normal), l); // small offset to avoid self-intersection
+        Statistics::count(Statistics::SHADOW_RAYS);
 
-        bool inShadow = intersect(shadowRay, shadowObject, shadowIntersectionPoint, shadowIntersectionNormal, shadowIntersectionT);
+        // only objects between the point and the light cast a shadow
+        bool inShadow = occluded(shadowRay, distance(lightsource.position, shadowRay.origin));
+        if (inShadow) Statistics::count(Statistics::HITS);
 
         if (!inShadow)
         {
-            double diffuse_part = std::max(dot(_normal, l), 0.0);
+            Scalar diffuse_part = std::max(dot(_normal, l), Scalar(0));
             vec3 diffuse_reflection_part = _material.diffuse * diffuse_part;
             if (diffuse_part)
             {
-                vec3 specular_reflection_part = _material.specular * pow(std::max(dot(mirror(l, _normal), _view), 0.0), _material.shininess);
+                vec3 specular_reflection_part = _material.specular * pow(std::max(dot(mirror(l, _normal), _view), Scalar(0)), _material.shininess);
                 diff_spec_shadows += lightsource.color * (diffuse_reflection_part + specular_reflection_part);
             }
         }
@@ -161,22 +675,64 @@ vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view,
 
 //-----------------------------------------------------------------------------
 
+void Scene::setHeatmap(Cost _cost)
+{
+    if (_cost != NO_COST && _cost != TIME && !Statistics::ENABLED)
+        throw std::runtime_error("Heatmaps of rays, boxes, or tests need a build with RAYTRACE_STATS");
+    heatmapCost = _cost;
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::setUseBVH(bool _use_bvh)
+{
+    useBVH = _use_bvh;
+    for (Mesh &mesh: meshes)
+        mesh.set_use_bvh(_use_bvh);
+    for (const auto &mesh: instancedMeshes)
+        mesh->set_use_bvh(_use_bvh);
+}
+
+//-----------------------------------------------------------------------------
+
 void Scene::read(const std::string &_filename)
 {
+    Profiler::Scope scope("parse");
+
     std::ifstream ifs(_filename);
     if (!ifs)
         throw std::runtime_error("Cannot open file " + _filename);
 
+    // Instances of the same mesh file with the same shading share one mesh,
+    // which is only loaded once.
+    std::map<std::string, std::shared_ptr<Mesh>> sharedMeshes;
+    auto instance = [&]() {
+        std::string meshFile;
+        Mesh::Draw_mode mode;
+        ifs >> meshFile >> mode;
+        const std::string path = Mesh::path(meshFile, _filename);
+        std::shared_ptr<Mesh> &mesh = sharedMeshes[path + (mode == Mesh::FLAT ? " FLAT" : " PHONG")];
+        if (!mesh)
+        {
+            mesh = std::make_shared<Mesh>(path, mode);
+            instancedMeshes.push_back(mesh);
+        }
+        instances.emplace_back(mesh, ifs);
+    };
+
     const std::map<std::string, std::function<void(void)>> entityParser = {
         {"depth",      [&]() { ifs >> max_depth; }},
         {"camera",     [&]() { ifs >> camera; }},
         {"background", [&]() { ifs >> background; }},
         {"ambience",   [&]() { ifs >> ambience; }},
+        {"bvh",        [&]() { ifs >> bvhQuality; }},
+        {"accelerator",[&]() { ifs >> accelerator; }},
         {"light",      [&]() { lights .emplace_back(ifs); }},
-        {"plane",      [&]() { objects.emplace_back(new    Plane(ifs)); }},
-        {"sphere",     [&]() { objects.emplace_back(new   Sphere(ifs)); }},
-        {"cylinder",   [&]() { objects.emplace_back(new Cylinder(ifs)); }},
-        {"mesh",       [&]() { objects.emplace_back(new     Mesh(ifs, _filename)); }}
+        {"plane",      [&]() { planes   .emplace_back(ifs); }},
+        {"sphere",     [&]() { spheres  .emplace_back(ifs); }},
+        {"cylinder",   [&]() { cylinders.emplace_back(ifs); }},
+        {"mesh",       [&]() { meshes   .emplace_back(ifs, _filename); }},
+        {"instance",   instance}
     };
 
     // parse file
@@ -191,6 +747,205 @@ void Scene::read(const std::string &_filename)
             throw std::runtime_error("Invalid token encountered: " + token);
         entityParser.at(token)();
     }
+
+    // The arrays are complete, so pointers to their elements stay valid.
+    // The bounded objects come first, in the order of withBoundedObject().
+    objects.clear();
+    forEachObject([&](const Object &o) {
+        objects.push_back(&o);
+        return false;
+    });
+    bvhObjects.assign(objects.begin(), objects.end() - planes.size());
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::buildBVH()
+{
+    StopWatch timer;
+    timer.start();
+
+    std::vector<Mesh *> loadMeshes;
+    for (Mesh &mesh: meshes)
+        loadMeshes.push_back(&mesh);
+    for (const auto &mesh: instancedMeshes)
+        loadMeshes.push_back(mesh.get());
+
+    // Load the meshes concurrently, together with their hierarchies from
+    // their caches where possible. Each task only writes to its own mesh and
+    // flags, and the objects keep the order of the scene file, so the scene
+    // does not depend on the order in which the tasks finish.
+    std::vector<char> cached(loadMeshes.size(), false), valid(loadMeshes.size(), false);
+#if HAVE_OPENMP
+#  pragma omp parallel if(loadMeshes.size() > 1)
+#  pragma omp single
+#endif
+    for (size_t i = 0; i < loadMeshes.size(); ++i)
+    {
+#if HAVE_OPENMP
+#  pragma omp task firstprivate(i)
+#endif
+        {
+            cached[i] = useMeshCache && loadMeshes[i]->read_cache(bvhQuality);
+            valid[i]  = cached[i] || loadMeshes[i]->read(loadMeshes[i]->filename());
+        }
+    }
+
+    // report the files in scene order, and remember which meshes still need
+    // a hierarchy and can be cached afterwards. Meshes that could not be
+    // read stay empty, without a hierarchy.
+    std::vector<Mesh *> readMeshes;
+    cachedMeshes = 0;
+    for (size_t i = 0; i < loadMeshes.size(); ++i)
+    {
+        Mesh *mesh = loadMeshes[i];
+        if (cached[i])
+            ++cachedMeshes;
+        else if (valid[i])
+            readMeshes.push_back(mesh);
+        if (valid[i])
+        {
+            std::cout << "\n  read " << mesh->filename() << (cached[i] ? ".cache: " : ": ")
+                      << mesh->num_vertices() << " vertices, " << mesh->num_triangles()
+                      << " triangles (" << mesh->load_time() << " ms";
+            if (mesh->parse_rate() > 0)
+                std::cout << ", " << std::round(mesh->parse_rate()) << " MB/s";
+            std::cout << ")";
+        }
+    }
+
+    loadTime = timer.stop();
+    timer.start();
+
+    // Build the meshes' hierarchies concurrently. The builds spawn tasks for
+    // their large subtrees, which are shared among the same threads.
+#if HAVE_OPENMP
+#  pragma omp parallel if(readMeshes.size() > 1)
+#  pragma omp single
+#endif
+    for (Mesh *mesh: readMeshes)
+    {
+#if HAVE_OPENMP
+#  pragma omp task firstprivate(mesh)
+#endif
+        mesh->build_bvh(bvhQuality);
+    }
+
+    // the next run can load these meshes from their caches
+    if (useMeshCache)
+    {
+        for (Mesh *mesh: readMeshes)
+        {
+            if (!mesh->write_cache(bvhQuality))
+                std::cerr << "\n  cannot write the cache of " << mesh->filename();
+        }
+    }
+
+    // the bounds of the meshes are known now
+    std::vector<vec3> bb_min(bvhObjects.size()), bb_max(bvhObjects.size());
+    for (size_t i = 0; i < bvhObjects.size(); ++i)
+        bvhObjects[i]->bounds(bb_min[i], bb_max[i]);
+
+    bvh.build(bb_min, bb_max, bvhQuality);
+
+    // copy the spheres into blocks: in their order for the linear search,
+    // and for each leaf of the hierarchy that contains any, together with
+    // the indices of the leaf's other objects
+    const unsigned int LANES = Sphere::SPHERE_LANES;
+    sphereBlocks.assign((spheres.size() + LANES - 1) / LANES, Sphere::SphereBlock());
+    for (unsigned int i = 0; i < sphereBlocks.size() * LANES; ++i)
+    {
+        // unused lanes of the last block refer to no object
+        if (i < spheres.size()) sphereBlocks[i / LANES].set(i % LANES, spheres[i], i);
+        else                    sphereBlocks[i / LANES].index[i % LANES] = ~0u;
+    }
+
+    leafSphereBlocks.clear();
+    leafSphereBlock.assign(bvh.num_primitives(), NO_SPHERE_BLOCK);
+    bvh.for_each_leaf([&](unsigned int first, unsigned int count) {
+        Sphere::SphereBlock block;
+        bool anySphere = false;
+        for (unsigned int l = 0; l < count; ++l)
+        {
+            const unsigned int i = bvh.primitive(first + l);
+            if (i < spheres.size())
+            {
+                block.set(l, spheres[i], i);
+                anySphere = true;
+            }
+            else
+            {
+                block.index[l] = i;
+            }
+        }
+        if (anySphere)
+        {
+            leafSphereBlock[first] = static_cast<unsigned int>(leafSphereBlocks.size());
+            leafSphereBlocks.push_back(block);
+        }
+    });
+
+    buildTime = timer.stop();
+
+    chooseAccelerator();
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::setAccelerator(Accelerator _accelerator)
+{
+    accelerator = _accelerator;
+    chooseAccelerator();
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::chooseAccelerator()
+{
+    std::vector<vec3> bb_min(bvhObjects.size()), bb_max(bvhObjects.size());
+    for (size_t i = 0; i < bvhObjects.size(); ++i)
+        bvhObjects[i]->bounds(bb_min[i], bb_max[i]);
+
+    useGrid = accelerator == GRID;
+    if (accelerator == AUTO && bvhObjects.size() >= GRID_MIN_OBJECTS)
+    {
+        // A grid only pays off if most cells hold few objects, which needs
+        // objects of similar size: compare the spread of their box diagonals
+        // to the mean.
+        double sum = 0.0, sum2 = 0.0;
+        for (size_t i = 0; i < bvhObjects.size(); ++i)
+        {
+            const double d = norm(bb_max[i] - bb_min[i]);
+            sum  += d;
+            sum2 += d * d;
+        }
+        const double mean = sum / bvhObjects.size();
+        const double variance = std::max(sum2 / bvhObjects.size() - mean * mean, 0.0);
+        useGrid = std::sqrt(variance) <= GRID_MAX_SIZE_VARIATION * mean;
+    }
+
+    if (useGrid && grid.empty() && !bvhObjects.empty())
+    {
+        StopWatch timer;
+        timer.start();
+        grid.build(bb_min, bb_max);
+        gridTime = timer.stop();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+double Scene::bvhCost() const
+{
+    // a mesh costs its bounding box test plus the traversal of its hierarchy
+    std::vector<double> cost(bvhObjects.size(), 1.0);
+    size_t i = spheres.size() + cylinders.size();
+    for (const Mesh &mesh: meshes)
+        cost[i++] += mesh.bvh_cost();
+    for (const Instance &instance: instances)
+        cost[i++] += instance.mesh().bvh_cost();
+
+    return bvh.expected_cost(cost) + planes.size();
 }
 
 
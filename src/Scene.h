@@ -14,15 +14,27 @@
 //== INCLUDES =================================================================
 
 #include "StopWatch.h"
+#include "Statistics.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
 #include "Object.h"
+#include "Sphere.h"
+#include "Plane.h"
+#include "Cylinder.h"
+#include "Mesh.h"
+#include "Instance.h"
 #include "Light.h"
 #include "Ray.h"
 #include "Material.h"
 #include "Image.h"
 #include "Camera.h"
+#include "BVH.h"
+#include "Grid.h"
+#include "Tile.h"
 
 #include <memory>
 #include <string>
+#include <optional>
 
 //== CLASS DEFINITION =========================================================
 
@@ -31,11 +43,43 @@
 /// objects
 class Scene {
 public:
-    /// Constructor loads scene from file.
-    Scene(const std::string &path) {
+    /// This type is used to choose how render() distributes the tiles over
+    /// threads: not at all, with OpenMP, or with the std::thread ThreadPool.
+    enum Backend {SERIAL, OPENMP, THREAD_POOL};
+
+    /// This type is used to choose the acceleration structure over the
+    /// bounded objects of the scene: a bounding volume hierarchy, a uniform
+    /// grid, or the one chosen by a heuristic (see setAccelerator()).
+    enum Accelerator {HIERARCHY, GRID, AUTO};
+
+    /// This type is used to choose the cost per pixel that render() records
+    /// in a heatmap: nothing, the time spent, or the number of rays traced
+    /// (primary, reflected, and shadow rays), of bounding boxes tested (see
+    /// Statistics::BOX_TESTS), or of objects and triangles tested.
+    enum Cost {NO_COST, TIME, RAYS, BOXES, TESTS};
+
+    /// Constructor loads scene from file and builds the bounding volume
+    /// hierarchies. If \c _bvhQuality is given, it overrides the build
+    /// quality set in the file. Meshes are loaded together with their
+    /// hierarchies from the binary caches next to the mesh files if these are
+    /// up to date, and the caches are (re)written otherwise, unless
+    /// \c _useMeshCache is false.
+    Scene(const std::string &path, std::optional<BVH::Quality> _bvhQuality = std::nullopt,
+          bool _useMeshCache = true) {
+        Profiler::Scope scope("load");
         read(path);
+        if (_bvhQuality) bvhQuality = *_bvhQuality;
+        useMeshCache = _useMeshCache;
+        buildBVH();
     }
 
+    /// The object lists and hierarchies point into the scene's own arrays
+    /// of objects, so a scene can neither be copied nor moved.
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+    Scene(Scene&&) = delete;
+    Scene& operator=(Scene&&) = delete;
+
     /// Allocate image and raytrace the scene.
     Image  render();
 
@@ -47,6 +91,15 @@ public:
     **/    
     vec3  trace(const Ray& _ray, int _depth);
 
+    /// Determine the colors seen by the viewing rays of a packet. The primary
+    /// intersections of all lanes are found together, reflections and shadows
+    /// are traced ray by ray.
+    /**
+    *    @param[in] _packet coherent primary rays
+    *    @param[out] _colors color of each active lane, as trace() computes it
+    **/
+    void  trace(const RayPacket& _packet, vec3 _colors[]);
+
     /// Computes the closest intersection point between a ray and all objects in the scene.
     /**
     *       @param _ray Ray that should be tested for intersections with all objects in the scene.
@@ -56,7 +109,28 @@ public:
     *       @param _t returns distance between the `_ray`'s origin and `_point`
     *       @return returns `true`, if there is an intersection point between `_ray` and at least one object in the scene.
     **/
-    bool  intersect(const Ray& _ray, Object_ptr&, vec3& _point, vec3& _normal, double& _t);
+    bool  intersect(const Ray& _ray, Object_ptr&, vec3& _point, vec3& _normal, Scalar& _t);
+
+    /// Computes the closest intersection of each active ray of a packet,
+    /// like intersect() does for a single ray.
+    /**
+    *       @param _packet Rays that should be tested for intersections with all objects in the scene.
+    *       @param _hit returns per lane whether there is an intersection; the other outputs are only set for those lanes.
+    *       @param _objects returns per lane the closest intersected object
+    *       @param _points returns per lane the intersection point
+    *       @param _normals returns per lane the normal at the intersection point
+    *       @param _t returns per lane the distance between ray origin and intersection point
+    **/
+    void  intersect(const RayPacket& _packet, bool _hit[], Object_ptr _objects[],
+                    vec3 _points[], vec3 _normals[], Scalar _t[]);
+
+    /// Checks whether any object in the scene blocks a ray segment.
+    /**
+    *       @param _ray Ray that should be tested for intersections with all objects in the scene.
+    *       @param _tmax Only intersections closer to the `_ray`'s origin than this are considered.
+    *       @return returns `true` as soon as any intersection in range is found.
+    **/
+    bool  occluded(const Ray& _ray, Scalar _tmax) const;
 
     /// Computes the phong lighting for a given object intersection
     /**
@@ -71,10 +145,112 @@ public:
 
     size_t numObjects() const { return objects.size(); }
 
+    /// Split strategy used to build the bounding volume hierarchies
+    BVH::Quality getBVHQuality() const { return bvhQuality; }
+
+    /// Time spent reading the mesh files or their caches in ms
+    double meshLoadTime() const { return loadTime; }
+
+    /// Number of meshes that were loaded from their caches
+    size_t numCachedMeshes() const { return cachedMeshes; }
+
+    /// Time spent building the bounding volume hierarchies (of the meshes
+    /// that were not cached) in ms
+    double bvhBuildTime() const { return buildTime; }
+
+    /// Expected cost of a ray hitting the scene according to the surface
+    /// area heuristic, counting node visits and primitive tests, where the
+    /// cost of a mesh is that of its own hierarchy.
+    double bvhCost() const;
+
+    /// Set the acceleration structure over the objects, overriding the one
+    /// set in the scene file. AUTO (default) chooses the grid for scenes of
+    /// many objects of similar size, like the atoms of a molecule, and the
+    /// hierarchy otherwise. The grid is built when it is first chosen.
+    void setAccelerator(Accelerator _accelerator);
+
+    /// Acceleration structure used over the objects, HIERARCHY or GRID
+    Accelerator getAccelerator() const { return useGrid ? GRID : HIERARCHY; }
+
+    /// Uniform grid over the objects, if it is used
+    const Grid &getGrid() const { return grid; }
+
+    /// Time spent building the grid in ms
+    double gridBuildTime() const { return gridTime; }
+
+    /// Set how render() runs in parallel. Without OpenMP support, OPENMP
+    /// falls back to THREAD_POOL.
+    void setBackend(Backend _backend) { renderBackend = _backend; }
+
+    /// Set the number of threads used by render(), 0 for one per core
+    void setNumThreads(unsigned int _threads) { numThreads = _threads; }
+
+    /// Set the edge length in pixels of the tiles the image is rendered in
+    void setTileSize(unsigned int _size) { tileSize = _size; }
+
+    /// Set the order in which the tiles are rendered
+    void setTileOrder(Tile::Order _order) { tileOrder = _order; }
+
+    /// Tiles of the last render(), in the order they were started, together
+    /// with the time spent on each of them.
+    const std::vector<Tile> &getTiles() const { return tiles; }
+
+    /// Record the cost of each pixel in render(), see getHeatmap(). All
+    /// costs but TIME are counted by Statistics, so they are only available
+    /// if it is compiled in (Statistics::ENABLED), and throw otherwise.
+    void setHeatmap(Cost _cost);
+
+    /// Counts of rays and tests of the last render(), merged from all
+    /// threads. They are zero unless Statistics::ENABLED.
+    const Statistics &getStatistics() const { return statistics; }
+
+    /// Cost of each pixel in the last render(), row by row, or nothing if it
+    /// was not recorded. Times are in nanoseconds. The pixels of a packet of
+    /// rays share its cost equally.
+    const std::vector<double> &getHeatmap() const { return heatmap; }
+
+    /// Use the bounding volume hierarchies of the scene and of the meshes
+    /// (default), or test every object and triangle (slow, for comparison).
+    void setUseBVH(bool _use_bvh);
+
+    /// Trace the primary rays in packets of RayPacket::SIZE (default), or
+    /// one by one.
+    void setUsePackets(bool _use_packets) { usePackets = _use_packets; }
+
     // Accessors for scene objects and camera for debugging.
-    const std::vector<std::unique_ptr<Object>> &getObjects() const { return objects; }
+    const std::vector<Object_ptr> &getObjects() const { return objects; }
     const Camera &getCamera() const { return camera; }
 
+private:
+    /// Load the meshes, from their caches where possible, build the
+    /// hierarchies of the others, sort the objects into bounded and
+    /// unbounded ones, and build the hierarchy over the bounded ones.
+    void buildBVH();
+
+    /// Resolve AUTO for the accelerator set in the scene file or by
+    /// setAccelerator(), and build the grid if it is needed.
+    void chooseAccelerator();
+
+    /// Call \c _f with the bounded object \c _i (an index into bvhObjects)
+    /// as a reference to its own type, such that the calls of its member
+    /// functions are not virtual and can be inlined. Return what \c _f returns.
+    template <class Function>
+    auto withBoundedObject(unsigned int _i, Function&& _f) const;
+
+    /// Call \c _f for each object as a reference to its own type, in the
+    /// order of getObjects(), until it returns true. Return whether it did.
+    template <class Function>
+    bool forEachObject(Function&& _f) const;
+
+    /// Same as forEachObject(), but without the spheres, which are tested in
+    /// blocks instead (see sphereBlocks)
+    template <class Function>
+    bool forEachNonSphere(Function&& _f) const;
+
+    /// Computes the color seen by \c _ray, which hits \c _object at
+    /// \c _point with normal \c _normal: local lighting plus reflections.
+    vec3  shade(const Ray& _ray, Object_ptr _object, const vec3& _point, const vec3& _normal, int _depth);
+
 private:
     /// camera stores eye position, view direction, and can generate primary rays
     Camera camera;
@@ -82,8 +258,108 @@ private:
     /// array for all lights in the scene
     std::vector<Light> lights;
 
-    /// array for all the objects in the scene
-    std::vector<std::unique_ptr<Object>> objects;
+    /// The objects of the scene, in one array per type, such that they can
+    /// be tested without virtual function calls. Planes are the only objects
+    /// without bounding box.
+    std::vector<Sphere>   spheres;
+    std::vector<Cylinder> cylinders;
+    std::vector<Mesh>     meshes;
+    std::vector<Instance> instances;
+    std::vector<Plane>    planes;
+
+    /// all objects: first the bounded ones (spheres, cylinders, meshes, and
+    /// instances), then the planes
+    std::vector<Object_ptr> objects;
+
+    /// meshes shared by the instances, one per mesh file and shading mode
+    std::vector<std::shared_ptr<Mesh>> instancedMeshes;
+
+    /// objects referenced by the leaves of bvh and the cells of grid, by
+    /// index: the bounded objects at the front of objects
+    std::vector<Object_ptr> bvhObjects;
+
+    /// bounding volume hierarchy over the bounded objects
+    BVH bvh;
+
+    /// the spheres in blocks of Sphere::SPHERE_LANES, in their order, which
+    /// the linear search tests with Sphere::intersect_spheres()
+    std::vector<Sphere::SphereBlock> sphereBlocks;
+
+    /// the spheres of each leaf of bvh that contains any, for the same
+    /// purpose. Lane l refers to position first + l of the leaf order of
+    /// bvh, and its index to the bounded object there.
+    std::vector<Sphere::SphereBlock> leafSphereBlocks;
+
+    /// index in leafSphereBlocks of the leaf that starts at a position of the
+    /// leaf order of bvh, or NO_SPHERE_BLOCK if it contains no sphere
+    std::vector<unsigned int> leafSphereBlock;
+
+    /// marks leaves without spheres in leafSphereBlock
+    static constexpr unsigned int NO_SPHERE_BLOCK = ~0u;
+
+    /// AUTO chooses the grid for at least this many bounded objects...
+    static constexpr size_t GRID_MIN_OBJECTS = 256;
+
+    /// ...if the standard deviation of the size of their boxes is at most
+    /// this fraction of the mean size
+    static constexpr double GRID_MAX_SIZE_VARIATION = 0.5;
+
+    /// uniform grid over the bounded objects, alternative to bvh
+    Grid grid;
+
+    /// acceleration structure set in the scene file or by setAccelerator()
+    Accelerator accelerator = AUTO;
+
+    /// use grid instead of bvh?
+    bool useGrid = false;
+
+    /// time spent building grid in ms
+    double gridTime = 0;
+
+    /// use bvh in intersect() instead of testing all objects?
+    bool useBVH = true;
+
+    /// trace primary rays in packets?
+    bool usePackets = true;
+
+    /// how to split the nodes of all hierarchies
+    BVH::Quality bvhQuality = BVH::BINNED_SAH;
+
+    /// load meshes from and write them to their caches?
+    bool useMeshCache = true;
+
+    /// time spent loading the meshes in buildBVH() in ms
+    double loadTime = 0;
+
+    /// number of meshes loaded from their caches
+    size_t cachedMeshes = 0;
+
+    /// time spent building hierarchies in buildBVH() in ms
+    double buildTime = 0;
+
+    /// how render() runs in parallel
+    Backend renderBackend = OPENMP;
+
+    /// number of render threads, 0 for one per core
+    unsigned int numThreads = 0;
+
+    /// edge length of the tiles in pixels
+    unsigned int tileSize = 16;
+
+    /// order in which the tiles are rendered
+    Tile::Order tileOrder = Tile::MORTON;
+
+    /// tiles of the last render() with their timings
+    std::vector<Tile> tiles;
+
+    /// counts of the last render()
+    Statistics statistics;
+
+    /// cost recorded per pixel by render()
+    Cost heatmapCost = NO_COST;
+
+    /// cost of each pixel of the last render(), if recorded
+    std::vector<double> heatmap;
 
     /// max recursion depth for mirroring
     int max_depth = 0;
@@ -95,6 +371,76 @@ private:
     vec3 ambience = vec3(0, 0, 0);
 };
 
+//-----------------------------------------------------------------------------
+
+/// read acceleration structure ("bvh", "grid", or "auto") from stream
+inline std::istream& operator>>(std::istream& is, Scene::Accelerator& a)
+{
+    std::string name;
+    is >> name;
+    if      (name == "bvh")  a = Scene::HIERARCHY;
+    else if (name == "grid") a = Scene::GRID;
+    else if (name == "auto") a = Scene::AUTO;
+    else throw std::runtime_error("Invalid accelerator " + name);
+    return is;
+}
+
+/// output acceleration structure
+inline std::ostream& operator<<(std::ostream& os, Scene::Accelerator a)
+{
+    switch (a)
+    {
+        case Scene::HIERARCHY: os << "bvh";  break;
+        case Scene::GRID:      os << "grid"; break;
+        case Scene::AUTO:      os << "auto"; break;
+    }
+    return os;
+}
+
+//-----------------------------------------------------------------------------
+
+/// read heatmap cost ("none", "time", "rays", "boxes", or "tests") from stream
+inline std::istream& operator>>(std::istream& is, Scene::Cost& c)
+{
+    std::string name;
+    is >> name;
+    if      (name == "none")  c = Scene::NO_COST;
+    else if (name == "time")  c = Scene::TIME;
+    else if (name == "rays")  c = Scene::RAYS;
+    else if (name == "boxes") c = Scene::BOXES;
+    else if (name == "tests") c = Scene::TESTS;
+    else throw std::runtime_error("Invalid heatmap cost " + name);
+    return is;
+}
+
+/// output heatmap cost
+inline std::ostream& operator<<(std::ostream& os, Scene::Cost c)
+{
+    switch (c)
+    {
+        case Scene::NO_COST: os << "none";  break;
+        case Scene::TIME:    os << "time";  break;
+        case Scene::RAYS:    os << "rays";  break;
+        case Scene::BOXES:   os << "boxes"; break;
+        case Scene::TESTS:   os << "tests"; break;
+    }
+    return os;
+}
+
+//-----------------------------------------------------------------------------
+
+/// read render backend ("serial", "openmp", or "threads") from stream
+inline std::istream& operator>>(std::istream& is, Scene::Backend& b)
+{
+    std::string name;
+    is >> name;
+    if      (name == "serial")  b = Scene::SERIAL;
+    else if (name == "openmp")  b = Scene::OPENMP;
+    else if (name == "threads") b = Scene::THREAD_POOL;
+    else throw std::runtime_error("Invalid render backend " + name);
+    return is;
+}
+
 //=============================================================================
 #endif // SCENE_H defined
 //=============================================================================
@@ -20,7 +20,7 @@
 /// @param[in]   a,b,c    coefficients of ax^2 + bx + c == 0
 /// @param[out]  solns    array holding between 0 and 2 solutions
 /// @return      number of solutions found
-inline size_t solveQuadratic(double a, double b, double c, std::array<double, 2> &solns) {
+inline size_t solveQuadratic(Scalar a, Scalar b, Scalar c, std::array<Scalar, 2> &solns) {
     // Handle degenerate (linear) case
     if (std::abs(a) < 1e-10) {
         if (std::abs(b) < 1e-10) return 0;
@@ -28,7 +28,7 @@ inline size_t solveQuadratic(double a, double b, double c, std::array<double, 2>
         return 1;
     }
 
-    double discriminant = b * b - 4 * a * c;
+    Scalar discriminant = b * b - 4 * a * c;
     if (discriminant < 0) return 0;
 
     // Avoid cancellation:
@@ -36,7 +36,7 @@ inline size_t solveQuadratic(double a, double b, double c, std::array<double, 2>
     //      a * x1 = 1 / 2 [-b - bSign * sqrt(b^2 - 4ac)]
     // "x2" can be found from the fact:
     //      a * x1 * x2 = c
-    double a_x1 = -0.5 * (b + copysign(std::sqrt(discriminant), b));
+    Scalar a_x1 = -0.5 * (b + copysign(std::sqrt(discriminant), b));
 
     solns = { a_x1 / a, c / a_x1 };
     return 2;
@@ -12,12 +12,90 @@
 //== INCLUDES =================================================================
 
 #include "Sphere.h"
-#include "SolveQuadratic.h"
 
 //== IMPLEMENTATION =========================================================
 
 
-Sphere::Sphere(const vec3& _center, double _radius)
+// As the triangle kernel in Mesh.cpp, the sphere kernel below is compiled for
+// plain x86-64 (SSE2) and for AVX2 where the compiler supports it.
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#  if __has_attribute(target_clones)
+#    define SPHERE_KERNEL_TARGETS __attribute__((target_clones("avx2", "default")))
+#  endif
+#endif
+#ifndef SPHERE_KERNEL_TARGETS
+#  define SPHERE_KERNEL_TARGETS
+#endif
+
+
+/// Test of one ray against the Sphere::SPHERE_LANES spheres of a block,
+/// written as a branch-free loop over the spheres so that it is vectorized.
+/// The arithmetic is exactly that of Sphere::intersect() and solveQuadratic()
+/// for rays that are not degenerate, i.e. for \c _a (the squared length of
+/// the direction) of at least 1e-10.
+SPHERE_KERNEL_TARGETS
+static unsigned int intersect_sphere_block(const Sphere::SphereBlock& _block,
+                                           const vec3& _origin, const vec3& _direction,
+                                           Scalar _a, Scalar* _t)
+{
+    const Scalar o0 = _origin[0],    o1 = _origin[1],    o2 = _origin[2];
+    const Scalar d0 = _direction[0], d1 = _direction[1], d2 = _direction[2];
+    const Scalar four_a = 4 * _a;
+
+    // coefficients b and c of the quadratic and its discriminant, for all
+    // spheres, which is enough to reject rays that miss them all
+    Scalar b[Sphere::SPHERE_LANES], c[Sphere::SPHERE_LANES], discriminant[Sphere::SPHERE_LANES];
+    int any = 0;
+    for (unsigned int l = 0; l < Sphere::SPHERE_LANES; ++l)
+    {
+        // oc = origin - center
+        const Scalar oc0 = o0 - _block.center[0][l];
+        const Scalar oc1 = o1 - _block.center[1][l];
+        const Scalar oc2 = o2 - _block.center[2][l];
+        b[l] = 2 * (d0*oc0 + d1*oc1 + d2*oc2);
+        c[l] = (oc0*oc0 + oc1*oc1 + oc2*oc2) - _block.sqr_radius[l];
+        discriminant[l] = b[l] * b[l] - four_a * c[l];
+        any |= !(discriminant[l] < 0);
+    }
+    if (!any) return 0;
+
+    // results are collected locally, so that the compiler knows that the
+    // loop does not write to its input
+    Scalar tl[Sphere::SPHERE_LANES];
+    int hit[Sphere::SPHERE_LANES];
+
+    for (unsigned int l = 0; l < Sphere::SPHERE_LANES; ++l)
+    {
+        // both solutions as in solveQuadratic(), with the square root of
+        // negative discriminants (no solution) replaced by zero
+        const Scalar root = std::sqrt(discriminant[l] < 0 ? Scalar(0) : discriminant[l]);
+        const Scalar a_x1 = Scalar(-0.5) * (b[l] + std::copysign(root, b[l]));
+        const Scalar t1 = a_x1 / _a;
+        const Scalar t2 = c[l] / a_x1;
+
+        // the closest solution in front of the ray origin, as in intersect()
+        Scalar t = Object::NO_INTERSECTION;
+        t = (t1 > 0 && t1 < t) ? t1 : t;
+        t = (t2 > 0 && t2 < t) ? t2 : t;
+
+        hit[l] = !(discriminant[l] < 0) & (t != Object::NO_INTERSECTION);
+        tl[l]  = t;
+    }
+
+    unsigned int mask = 0;
+    for (unsigned int l = 0; l < Sphere::SPHERE_LANES; ++l)
+    {
+        _t[l] = tl[l];
+        mask |= static_cast<unsigned int>(hit[l]) << l;
+    }
+    return mask;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Sphere::Sphere(const vec3& _center, Scalar _radius)
 : center(_center), radius(_radius)
 {
 }
@@ -28,33 +106,53 @@ Sphere::Sphere(const vec3& _center, double _radius)
 
 bool
 Sphere::
-intersect(const Ray&  _ray,
-          vec3&       _intersection_point,
-          vec3&       _intersection_normal,
-          double&     _intersection_t) const
+bounds(vec3& _bb_min, vec3& _bb_max) const
 {
+    _bb_min = center - vec3(radius);
+    _bb_max = center + vec3(radius);
+    return true;
+}
 
-    const vec3 &dir = _ray.direction;
-    const vec3   oc = _ray.origin - center;
+//-----------------------------------------------------------------------------
 
-    std::array<double, 2> t;
-    size_t nsol = solveQuadratic(dot(dir, dir),
-                                 2 * dot(dir, oc),
-                                 dot(oc, oc) - radius * radius, t);
 
-    _intersection_t = NO_INTERSECTION;
+void
+Sphere::SphereBlock::
+set(unsigned int _lane, const Sphere& _sphere, unsigned int _index)
+{
+    for (int i = 0; i < 3; ++i)
+        center[i][_lane] = _sphere.center[i];
+    sqr_radius[_lane] = _sphere.radius * _sphere.radius;
+    index[_lane]      = _index;
+}
 
-    // Find the closest valid solution (in front of the viewer)
-    for (size_t i = 0; i < nsol; ++i) {
-        if (t[i] > 0) _intersection_t = std::min(_intersection_t, t[i]);
-    }
 
-    if (_intersection_t == NO_INTERSECTION) return false;
+//-----------------------------------------------------------------------------
 
-    _intersection_point  = _ray(_intersection_t);
-    _intersection_normal = (_intersection_point - center) / radius;
 
-    return true;
+unsigned int
+Sphere::
+intersect_spheres(const SphereBlock& _block, const Ray& _ray, Scalar _t[SPHERE_LANES])
+{
+    const Scalar a = dot(_ray.direction, _ray.direction);
+    if (!(std::abs(a) < 1e-10))
+        return intersect_sphere_block(_block, _ray.origin, _ray.direction, a, _t);
+
+    // degenerate rays are handled by solveQuadratic() sphere by sphere
+    unsigned int mask = 0;
+    for (unsigned int l = 0; l < SPHERE_LANES; ++l)
+    {
+        const vec3 oc = _ray.origin - vec3(_block.center[0][l], _block.center[1][l], _block.center[2][l]);
+        std::array<Scalar, 2> t;
+        const size_t nsol = solveQuadratic(a, 2 * dot(_ray.direction, oc),
+                                           dot(oc, oc) - _block.sqr_radius[l], t);
+        _t[l] = NO_INTERSECTION;
+        for (size_t i = 0; i < nsol; ++i) {
+            if (t[i] > 0) _t[l] = std::min(_t[l], t[i]);
+        }
+        if (_t[l] != NO_INTERSECTION) mask |= 1u << l;
+    }
+    return mask;
 }
 
 //=============================================================================
@@ -16,6 +16,8 @@
 
 #include "Object.h"
 #include "vec3.h"
+#include "BVH.h"
+#include "SolveQuadratic.h"
 
 
 //== CLASS DEFINITION =========================================================
@@ -24,11 +26,11 @@
 /// \class Sphere Sphere.h
 /// This class implements a sphere object, which is specified by its center
 /// and its radius. This class overrides the intersection method Object::intersect().
-class Sphere : public Object
+class Sphere final : public Object
 {
 public:
     /// Construct a sphere by specifying center and radius
-    Sphere(const vec3& _center=vec3(0,0,0), double _radius=1);
+    Sphere(const vec3& _center=vec3(0,0,0), Scalar _radius=1);
 
     /// Construct a sphere with parameters parsed from an input stream.
     Sphere(std::istream &is) { parse(is); }
@@ -43,21 +45,149 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const override;
+                           Scalar&     _intersection_t) const override;
+
+    /// Intersect the sphere with the rays of a packet one by one, calling
+    /// intersect() directly instead of through the virtual function.
+    /// This function overrides Object::intersect_packet().
+    virtual void intersect_packet(const RayPacket& _packet,
+                                  const bool        _lanes[],
+                                  bool              _hit[],
+                                  vec3              _intersection_point[],
+                                  vec3              _intersection_normal[],
+                                  Scalar            _intersection_t[]) const override;
+
+    /// Is there an intersection of the sphere with \c _ray before \c _tmax?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray, Scalar _tmax) const override;
+
+    /// Bounding box of the sphere. This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override;
 
     /// parse sphere from an input stream
     virtual void parse(std::istream &is) override {
         is >> center >> radius >> material;
     }
 
+    /// number of spheres intersect_spheres() tests at once, which is the
+    /// maximum number of primitives in a leaf of a hierarchy
+    static constexpr unsigned int SPHERE_LANES = BVH::MAX_LEAF_SIZE;
+
+    /// Several spheres with everything needed to intersect them and nothing
+    /// else: center and squared radius, one array per coordinate ("structure
+    /// of arrays"), and an index that identifies each sphere to the caller.
+    /// Lanes that were not set hold empty spheres, which callers ignore.
+    struct alignas(64) SphereBlock
+    {
+        /// store \c _sphere in lane \c _lane, together with its index
+        void set(unsigned int _lane, const Sphere& _sphere, unsigned int _index);
+
+        /// center of each sphere
+        Scalar center[3][SPHERE_LANES] = {};
+        /// squared radius of each sphere
+        Scalar sqr_radius[SPHERE_LANES] = {};
+        /// index of each sphere
+        unsigned int index[SPHERE_LANES] = {};
+    };
+
+    /// Intersect \c _ray with the spheres of \c _block, all at once. Per
+    /// sphere, the result is the same as that of intersect().
+    /// \param[in] _block the spheres to intersect the ray with
+    /// \param[in] _ray the ray to intersect the spheres with
+    /// \param[out] _t ray parameter of the closest hit of each sphere that is hit
+    /// \return bit mask of the spheres that are hit
+    static unsigned int intersect_spheres(const SphereBlock& _block, const Ray& _ray,
+                                          Scalar _t[SPHERE_LANES]);
+
 private:
     /// center position of the sphere
     vec3   center;
 
     /// radius of the sphere
-    double radius;
+    Scalar radius;
 };
 
+
+//== IMPLEMENTATION ===========================================================
+
+// The intersection tests are defined here, such that they can be inlined
+// where the type of the sphere is known, e.g. in the loops of Scene over
+// its array of spheres.
+
+
+inline bool
+Sphere::
+intersect(const Ray&  _ray,
+          vec3&       _intersection_point,
+          vec3&       _intersection_normal,
+          Scalar&     _intersection_t) const
+{
+    const vec3 &dir = _ray.direction;
+    const vec3   oc = _ray.origin - center;
+
+    std::array<Scalar, 2> t;
+    size_t nsol = solveQuadratic(dot(dir, dir),
+                                 2 * dot(dir, oc),
+                                 dot(oc, oc) - radius * radius, t);
+
+    _intersection_t = NO_INTERSECTION;
+
+    // Find the closest valid solution (in front of the viewer)
+    for (size_t i = 0; i < nsol; ++i) {
+        if (t[i] > 0) _intersection_t = std::min(_intersection_t, t[i]);
+    }
+
+    if (_intersection_t == NO_INTERSECTION) return false;
+
+    _intersection_point  = _ray(_intersection_t);
+    _intersection_normal = (_intersection_point - center) / radius;
+
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+inline void
+Sphere::
+intersect_packet(const RayPacket& _packet,
+                 const bool        _lanes[],
+                 bool              _hit[],
+                 vec3              _intersection_point[],
+                 vec3              _intersection_normal[],
+                 Scalar            _intersection_t[]) const
+{
+    for (int l = 0; l < RayPacket::SIZE; ++l)
+    {
+        if (_lanes[l])
+            _hit[l] = Sphere::intersect(_packet.rays[l], _intersection_point[l],
+                                        _intersection_normal[l], _intersection_t[l]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+inline bool
+Sphere::
+occluded(const Ray& _ray, Scalar _tmax) const
+{
+    const vec3 &dir = _ray.direction;
+    const vec3   oc = _ray.origin - center;
+
+    std::array<Scalar, 2> t;
+    size_t nsol = solveQuadratic(dot(dir, dir),
+                                 2 * dot(dir, oc),
+                                 dot(oc, oc) - radius * radius, t);
+
+    for (size_t i = 0; i < nsol; ++i) {
+        if (t[i] > 0 && t[i] < _tmax) return true;
+    }
+    return false;
+}
+
 //=============================================================================
 #endif // SPHERE_H defined
 //=============================================================================
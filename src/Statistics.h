@@ -0,0 +1,106 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+
+//== INCLUDES =================================================================
+
+#include <cstdint>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Statistics Statistics.h
+/// This class counts the work done while tracing rays: the rays of each kind,
+/// the bounding boxes, objects, and triangles they are tested against, and
+/// how many of them hit something. Each thread counts in its own instance,
+/// see local(), so counting needs no synchronization; the counts of several
+/// threads are merged with operator+=(). The counters are only compiled in
+/// if RAYTRACE_STATS is 1 (the CMake option RAYTRACE_STATS); otherwise
+/// count() does nothing and the counters cost nothing.
+class Statistics
+{
+public:
+
+    /// the things that are counted
+    enum Counter
+    {
+        PRIMARY_RAYS,    ///< rays from the camera
+        REFLECTION_RAYS, ///< rays reflected by mirrors
+        SHADOW_RAYS,     ///< rays towards the lights
+        BOX_TESTS,       ///< nodes of hierarchies, boxes of meshes, and cells of grids
+        OBJECT_TESTS,    ///< objects of the scene
+        TRIANGLE_TESTS,  ///< triangles of meshes
+        HITS,            ///< rays that hit an object, or shadow rays that are blocked
+        NUM_COUNTERS
+    };
+
+    /// Are the counters compiled in?
+    static constexpr bool ENABLED = RAYTRACE_STATS;
+
+    /// Add \c _n to counter \c _counter of the calling thread
+    static void count(Counter _counter, uint64_t _n = 1)
+    {
+#if RAYTRACE_STATS
+        local_.counts_[_counter] += _n;
+#else
+        (void)_counter;
+        (void)_n;
+#endif
+    }
+
+    /// The counters of the calling thread
+    static const Statistics& local() { return local_; }
+
+    /// Value of counter \c _counter
+    uint64_t operator[](Counter _counter) const { return counts_[_counter]; }
+
+    /// Number of rays of all kinds
+    uint64_t rays() const { return counts_[PRIMARY_RAYS] + counts_[REFLECTION_RAYS] + counts_[SHADOW_RAYS]; }
+
+    /// Number of objects and triangles tested
+    uint64_t tests() const { return counts_[OBJECT_TESTS] + counts_[TRIANGLE_TESTS]; }
+
+    /// Add the counts of \c _other, e.g. those of another thread
+    Statistics& operator+=(const Statistics& _other)
+    {
+        for (int i = 0; i < NUM_COUNTERS; ++i)
+            counts_[i] += _other.counts_[i];
+        return *this;
+    }
+
+    /// Counts since \c _before, which is an earlier state of the same counters
+    Statistics operator-(const Statistics& _before) const
+    {
+        Statistics result;
+        for (int i = 0; i < NUM_COUNTERS; ++i)
+            result.counts_[i] = counts_[i] - _before.counts_[i];
+        return result;
+    }
+
+private:
+
+    /// the counters, indexed by Counter
+    uint64_t counts_[NUM_COUNTERS] = {};
+
+    /// the counters of each thread
+    static thread_local Statistics local_;
+};
+
+
+inline thread_local Statistics Statistics::local_;
+
+
+//=============================================================================
+#endif // STATISTICS_H defined
+//=============================================================================
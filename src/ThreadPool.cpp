@@ -0,0 +1,159 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+ThreadPool::ThreadPool(unsigned int _num_threads)
+{
+    if (!_num_threads)
+        _num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < _num_threads; ++i)
+        queues_.emplace_back(new Queue);
+
+    for (unsigned int i = 1; i < _num_threads; ++i)
+        threads_.emplace_back(&ThreadPool::worker, this, i);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+
+    for (std::thread& thread : threads_)
+        thread.join();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void ThreadPool::parallel_for(unsigned int _n,
+                              const std::function<void(unsigned int, unsigned int)>& _task)
+{
+    // hand out contiguous blocks, so that neighboring items (e.g. tiles in
+    // Morton order) are processed by the same thread
+    const unsigned int n_threads = num_threads();
+    for (unsigned int t = 0; t < n_threads; ++t)
+    {
+        Queue& queue = *queues_[t];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (unsigned int i = _n * t / n_threads; i < _n * (t + 1) / n_threads; ++i)
+            queue.items.push_back(i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &_task;
+        busy_ = n_threads - 1;
+        ++generation_;
+    }
+    start_.notify_all();
+
+    // the calling thread works as well
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+    task_ = nullptr;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void ThreadPool::worker(unsigned int _id)
+{
+    unsigned long generation = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&] { return stop_ || generation_ != generation; });
+            if (stop_) return;
+            generation = generation_;
+        }
+
+        work(_id);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busy_;
+        }
+        done_.notify_one();
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void ThreadPool::work(unsigned int _id)
+{
+    unsigned int item;
+    while (next_item(_id, item))
+        (*task_)(item, _id);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool ThreadPool::next_item(unsigned int _id, unsigned int& _item)
+{
+    // own queue first, in order
+    {
+        Queue& queue = *queues_[_id];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.items.empty())
+        {
+            _item = queue.items.front();
+            queue.items.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of the other queues, i.e. the work their owners
+    // would have done last
+    const unsigned int n_threads = num_threads();
+    for (unsigned int i = 1; i < n_threads; ++i)
+    {
+        Queue& queue = *queues_[(_id + i) % n_threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.items.empty())
+        {
+            _item = queue.items.back();
+            queue.items.pop_back();
+            return true;
+        }
+    }
+
+    // no new items are added during a parallel_for(), so we are done
+    return false;
+}
+
+
+//=============================================================================
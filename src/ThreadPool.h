@@ -0,0 +1,106 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+
+//== INCLUDES =================================================================
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class ThreadPool ThreadPool.h
+/// A portable pool of worker threads based on std::thread, used for
+/// rendering when OpenMP is not available (or not wanted). Work items are
+/// distributed over per-thread queues in contiguous blocks; each thread works
+/// through its own queue from the front and, when it runs dry, steals items
+/// from the back of the other threads' queues.
+class ThreadPool
+{
+public:
+
+    /// Start a pool of \c _num_threads threads, including the calling thread,
+    /// which takes part in parallel_for(). 0 means one per hardware thread.
+    explicit ThreadPool(unsigned int _num_threads = 0);
+
+    /// Stop and join all worker threads.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Number of threads working on parallel_for(), including the caller
+    unsigned int num_threads() const { return static_cast<unsigned int>(queues_.size()); }
+
+    /// Call \c _task(i) for all i in [0, _n) in parallel and return when all
+    /// calls are done. The calling thread gets the lowest thread id 0.
+    /// \param[in] _n number of work items
+    /// \param[in] _task callback <tt>void(unsigned int item, unsigned int thread)</tt>
+    void parallel_for(unsigned int _n,
+                      const std::function<void(unsigned int, unsigned int)>& _task);
+
+private:
+
+    /// a work queue, owned by one thread but accessible by all
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<unsigned int> items;
+    };
+
+    /// main loop of the worker thread \c _id
+    void worker(unsigned int _id);
+
+    /// Process work items until all queues are empty.
+    void work(unsigned int _id);
+
+    /// Take the next item from the own queue, or steal one from another
+    /// thread. Return false if there is no work left.
+    bool next_item(unsigned int _id, unsigned int& _item);
+
+private:
+
+    /// worker threads, the calling thread is not in here
+    std::vector<std::thread> threads_;
+
+    /// work queues, one per thread (index 0 belongs to the calling thread)
+    std::vector<std::unique_ptr<Queue>> queues_;
+
+    /// protects the members below
+    std::mutex mutex_;
+    /// signals the start of a parallel_for() or the end of the pool
+    std::condition_variable start_;
+    /// signals that a worker thread is done with the current parallel_for()
+    std::condition_variable done_;
+
+    /// task of the current parallel_for()
+    const std::function<void(unsigned int, unsigned int)>* task_ = nullptr;
+    /// incremented for every parallel_for(), so workers notice new work
+    unsigned long generation_ = 0;
+    /// number of worker threads still busy with the current parallel_for()
+    unsigned int busy_ = 0;
+    /// set when the pool is destroyed
+    bool stop_ = false;
+};
+
+
+//=============================================================================
+#endif // THREADPOOL_H defined
+//=============================================================================
@@ -0,0 +1,102 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Tile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// interleave the bits of \c _x and \c _y to get the tile's position on a
+/// Morton curve
+static uint64_t morton_code(uint32_t _x, uint32_t _y)
+{
+    uint64_t code = 0;
+    for (int i = 0; i < 32; ++i)
+    {
+        code |= uint64_t((_x >> i) & 1) << (2 * i);
+        code |= uint64_t((_y >> i) & 1) << (2 * i + 1);
+    }
+    return code;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::vector<Tile> make_tiles(unsigned int _width, unsigned int _height,
+                             unsigned int _size, Tile::Order _order)
+{
+    _size = std::max(_size, 1u);
+    const unsigned int nx = (_width  + _size - 1) / _size;
+    const unsigned int ny = (_height + _size - 1) / _size;
+
+    // sort keys of the tiles: (major, minor)
+    struct Key { double major, minor; unsigned int tx, ty; };
+    std::vector<Key> keys;
+    keys.reserve(nx * ny);
+
+    for (unsigned int ty = 0; ty < ny; ++ty)
+    {
+        for (unsigned int tx = 0; tx < nx; ++tx)
+        {
+            Key key{0, 0, tx, ty};
+            switch (_order)
+            {
+                case Tile::SCANLINE:
+                    key.major = ty * nx + tx;
+                    break;
+
+                case Tile::MORTON:
+                    key.major = double(morton_code(tx, ty));
+                    break;
+
+                case Tile::SPIRAL:
+                {
+                    // ring around the center tile, then angle within the ring
+                    const double dx = tx - 0.5 * (nx - 1);
+                    const double dy = ty - 0.5 * (ny - 1);
+                    key.major = std::round(std::max(std::abs(dx), std::abs(dy)));
+                    key.minor = std::atan2(dy, dx);
+                    break;
+                }
+            }
+            keys.push_back(key);
+        }
+    }
+
+    std::stable_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+        return a.major < b.major || (a.major == b.major && a.minor < b.minor);
+    });
+
+    std::vector<Tile> tiles;
+    tiles.reserve(keys.size());
+    for (const Key& key : keys)
+    {
+        Tile tile;
+        tile.x0 = key.tx * _size;
+        tile.y0 = key.ty * _size;
+        tile.x1 = std::min(tile.x0 + _size, _width);
+        tile.y1 = std::min(tile.y0 + _size, _height);
+        tiles.push_back(tile);
+    }
+
+    return tiles;
+}
+
+
+//=============================================================================
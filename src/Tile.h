@@ -0,0 +1,87 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef TILE_H
+#define TILE_H
+
+
+//== INCLUDES =================================================================
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Tile Tile.h
+/// A rectangular block of pixels that is rendered as one work item. Scene
+/// renders the image tile by tile, handing out the tiles to the threads in
+/// the order produced by make_tiles(), and records the time spent per tile.
+struct Tile
+{
+    /// This type is used to choose the order in which tiles are rendered:
+    /// row by row, along a Morton (Z-order) curve, or in a spiral from the
+    /// image center outwards.
+    enum Order {SCANLINE, MORTON, SPIRAL};
+
+    /// first pixel column of the tile
+    unsigned int x0;
+    /// first pixel row of the tile
+    unsigned int y0;
+    /// one past the last pixel column of the tile
+    unsigned int x1;
+    /// one past the last pixel row of the tile
+    unsigned int y1;
+
+    /// time spent rendering the tile in ms
+    double time = 0;
+};
+
+
+/// Cover a \c _width x \c _height image with tiles of \c _size x \c _size
+/// pixels (smaller at the right and top border), sorted by \c _order.
+std::vector<Tile> make_tiles(unsigned int _width, unsigned int _height,
+                             unsigned int _size, Tile::Order _order);
+
+
+//-----------------------------------------------------------------------------
+
+
+/// read tile order ("scanline", "morton", or "spiral") from stream
+inline std::istream& operator>>(std::istream& is, Tile::Order& o)
+{
+    std::string name;
+    is >> name;
+    if      (name == "scanline") o = Tile::SCANLINE;
+    else if (name == "morton")   o = Tile::MORTON;
+    else if (name == "spiral")   o = Tile::SPIRAL;
+    else throw std::runtime_error("Invalid tile order " + name);
+    return is;
+}
+
+/// output tile order
+inline std::ostream& operator<<(std::ostream& os, Tile::Order o)
+{
+    switch (o)
+    {
+        case Tile::SCANLINE: os << "scanline"; break;
+        case Tile::MORTON:   os << "morton";   break;
+        case Tile::SPIRAL:   os << "spiral";   break;
+    }
+    return os;
+}
+
+
+//=============================================================================
+#endif // TILE_H defined
+//=============================================================================
@@ -56,7 +56,7 @@ int main(int argc, char **argv) {
                 Ray ray = c.primary_ray(x,y);
 
                 for (const auto &o: s.getObjects()) {
-                    if (auto mesh = dynamic_cast<const Mesh *>(o.get())) {
+                    if (auto mesh = dynamic_cast<const Mesh *>(o)) {
                         if (mesh->intersect_bounding_box(ray))
                             ++numIntersected[y * c.width + x];
                     }
@@ -0,0 +1,177 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "Image.h"
+
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// Differences between two images of the same size, in 8 bit color levels
+struct Difference
+{
+    double psnr = std::numeric_limits<double>::infinity(); ///< peak signal to noise ratio in dB
+    int max_error = 0;                                     ///< largest difference of a color channel
+    size_t differing_pixels = 0;                           ///< pixels with any difference
+};
+
+
+/// 8 bit level of the color channel value \c _c, as stored by Image::write()
+static int level(Scalar _c)
+{
+    return int(std::lround(255 * _c));
+}
+
+
+/// Compare \c _image to \c _reference (of the same size). If \c _diff is
+/// given, it is set to the reference in dimmed gray, with the differing pixels
+/// in red, the brighter the larger their error.
+static Difference compare(const Image &_reference, const Image &_image, Image *_diff)
+{
+    Difference difference;
+    double squared_error = 0;
+    std::vector<int> errors(size_t(_image.width()) * _image.height());
+    for (unsigned int y = 0; y < _image.height(); ++y)
+    {
+        for (unsigned int x = 0; x < _image.width(); ++x)
+        {
+            int error = 0;
+            for (int i = 0; i < 3; ++i)
+            {
+                const int e = std::abs(level(_image(x, y)[i]) - level(_reference(x, y)[i]));
+                squared_error += double(e) * e;
+                error = std::max(error, e);
+            }
+            errors[size_t(y) * _image.width() + x] = error;
+            difference.max_error = std::max(difference.max_error, error);
+            difference.differing_pixels += error > 0;
+        }
+    }
+
+    const double mse = squared_error / (3.0 * errors.size());
+    if (mse > 0) difference.psnr = 10.0 * std::log10(255.0 * 255.0 / mse);
+
+    if (_diff)
+    {
+        _diff->resize(_image.width(), _image.height());
+        for (unsigned int y = 0; y < _image.height(); ++y)
+        {
+            for (unsigned int x = 0; x < _image.width(); ++x)
+            {
+                const int error = errors[size_t(y) * _image.width() + x];
+                const vec3 &c = _reference(x, y);
+                (*_diff)(x, y) = error ? vec3(Scalar(0.5) + Scalar(0.5) * error / difference.max_error, 0, 0)
+                                       : vec3(Scalar(0.25) * (c[0] + c[1] + c[2]) / 3);
+            }
+        }
+    }
+    return difference;
+}
+
+
+/// Program entry point. Compares images with reference images and reports
+/// whether they are close enough, e.g. to check the images of an optimized
+/// build against those of a trusted build.
+int main(int argc, char **argv)
+{
+    double minPSNR = 0;
+    int maxError = 0;
+    std::string diffPath;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--min-psnr" && i + 1 < argc)
+            minPSNR = std::stod(argv[++i]);
+        else if (arg == "--max-error" && i + 1 < argc)
+            maxError = std::stoi(argv[++i]);
+        else if (arg == "--diff" && i + 1 < argc)
+            diffPath = argv[++i];
+        else
+            args.push_back(arg);
+    }
+
+    if (args.size() != 2) {
+        std::cerr << "Usage: " << argv[0] << " [options] reference.tga image.tga\n";
+        std::cerr << "Or: " << argv[0] << " [options] reference_dir image_dir\n";
+        std::cerr << "Compares the image(s) with the reference(s), for directories each .tga file of\n";
+        std::cerr << "reference_dir with the one of the same name in image_dir, and fails unless\n";
+        std::cerr << "all of them are within the thresholds. By default, they have to be identical.\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --min-psnr <dB>    minimum peak signal to noise ratio (default 0)\n";
+        std::cerr << "  --max-error <e>    maximum difference of a color channel, 0 to 255 (default 0)\n";
+        std::cerr << "  --diff <path>      write an image of the differing pixels to this file, or for\n";
+        std::cerr << "                     directories, <name>_diff.tga to this directory\n";
+        std::cerr << std::flush;
+        exit(1);
+    }
+
+    // pairs of reference and image, and where to write their difference
+    struct Job { std::string name, reference, image, diff; };
+    std::vector<Job> jobs;
+    if (std::filesystem::is_directory(args[0])) {
+        for (const auto &entry : std::filesystem::directory_iterator(args[0])) {
+            if (entry.path().extension() != ".tga") continue;
+            const std::string name = entry.path().filename().string();
+            const std::string stem = entry.path().stem().string();
+            jobs.push_back(Job{name, entry.path().string(), (std::filesystem::path(args[1]) / name).string(),
+                               diffPath.empty() ? "" : (std::filesystem::path(diffPath) / (stem + "_diff.tga")).string()});
+        }
+        std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.name < b.name; });
+        if (!diffPath.empty()) std::filesystem::create_directories(diffPath);
+    }
+    else {
+        jobs.push_back(Job{args[1], args[0], args[1], diffPath});
+    }
+
+    unsigned int failed = 0;
+    for (const Job &job : jobs) {
+        std::cout << job.name << ": ";
+
+        Image reference, image;
+        if (!reference.read(job.reference) || !image.read(job.image)) {
+            std::cout << "cannot read " << (reference.width() ? job.image : job.reference) << "  FAILED\n";
+            ++failed;
+            continue;
+        }
+        if (reference.width() != image.width() || reference.height() != image.height()) {
+            std::cout << "size " << image.width() << "x" << image.height() << " instead of "
+                      << reference.width() << "x" << reference.height() << "  FAILED\n";
+            ++failed;
+            continue;
+        }
+
+        Image diff;
+        const Difference d = compare(reference, image, job.diff.empty() ? nullptr : &diff);
+        const bool ok = d.psnr >= minPSNR && d.max_error <= maxError;
+        failed += !ok;
+
+        std::cout << "PSNR " << std::fixed << std::setprecision(2) << d.psnr << " dB, max error "
+                  << d.max_error << ", " << d.differing_pixels << " of " << size_t(image.width()) * image.height()
+                  << " pixels differ  " << (ok ? "ok" : "FAILED") << "\n";
+
+        if (d.differing_pixels && !job.diff.empty())
+            diff.write(job.diff);
+    }
+
+    std::cout << jobs.size() - failed << " of " << jobs.size() << " images ok" << std::endl;
+    return failed || jobs.empty() ? 1 : 0;
+}
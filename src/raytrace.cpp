@@ -17,6 +17,10 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <optional>
+#include <algorithm>
+#include <numeric>
 
 #ifdef _WIN32
 #  include <windows.h>
@@ -24,6 +28,32 @@
 #  include <errhandlingapi.h>
 #endif
 
+/// Image of the costs \c _cost of the pixels of a \c _width x \c _height
+/// image, mapped to colors from black over blue, red, and yellow to white.
+/// The most expensive percent of the pixels are white, such that a few
+/// outliers (e.g. pixels whose thread was preempted) do not darken the rest.
+static Image heatmap_image(const std::vector<double> &_cost, unsigned int _width, unsigned int _height)
+{
+    static const vec3 ramp[] = {vec3(0, 0, 0), vec3(0, 0, 1), vec3(1, 0, 0), vec3(1, 1, 0), vec3(1, 1, 1)};
+    const int segments = sizeof(ramp) / sizeof(ramp[0]) - 1;
+
+    std::vector<double> sorted(_cost);
+    auto percentile = sorted.begin() + sorted.size() * 99 / 100;
+    std::nth_element(sorted.begin(), percentile, sorted.end());
+    const double maxCost = sorted.empty() ? 0.0 : *percentile;
+    Image img(_width, _height);
+    for (unsigned int y = 0; y < _height; ++y) {
+        for (unsigned int x = 0; x < _width; ++x) {
+            const double c = maxCost > 0 ? std::min(_cost[size_t(y) * _width + x] / maxCost, 1.0) * segments : 0.0;
+            const int i = std::min(int(c), segments - 1);
+            const Scalar f = Scalar(c - i);
+            img(x, y) = (1 - f) * ramp[i] + f * ramp[i + 1];
+        }
+    }
+    return img;
+}
+
+
 /// Program entry point.
 int main(int argc, char **argv)
 {
@@ -33,13 +63,80 @@ int main(int argc, char **argv)
     // any signs of a an application crash!
     SetErrorMode(0);
 #endif
-    // Parse input scene file/output path from command line arguments
+    // Parse options and input scene file/output path from command line arguments
     struct RaytraceJob { std::string scenePath, outPath; };
     std::vector<RaytraceJob> jobs;
+    std::vector<std::string> args;
+    bool useBVH = true;
+    bool usePackets = true;
+    bool useMeshCache = true;
+    std::optional<BVH::Quality> bvhQuality;
+    std::optional<Scene::Accelerator> accelerator;
+    unsigned int tileSize = 16;
+    Tile::Order tileOrder = Tile::MORTON;
+    std::string tileTimesPath;
+    Scene::Backend backend = Scene::OPENMP;
+    unsigned int numThreads = 0;
+    Scene::Cost heatmapCost = Scene::NO_COST;
+    std::string profilePath;
+    Profiler::Clock profileClock = Profiler::STEADY_CLOCK;
+    bool usePerfCounters = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--linear")
+            useBVH = false;
+        else if (arg == "--no-packets")
+            usePackets = false;
+        else if (arg == "--no-mesh-cache")
+            useMeshCache = false;
+        else if (arg == "--bvh" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            bvhQuality.emplace();
+            ss >> *bvhQuality;
+        }
+        else if (arg == "--accel" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            accelerator.emplace();
+            ss >> *accelerator;
+        }
+        else if (arg == "--tile-size" && i + 1 < argc)
+            tileSize = std::stoi(argv[++i]);
+        else if (arg == "--tile-order" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            ss >> tileOrder;
+        }
+        else if (arg == "--tile-times" && i + 1 < argc)
+            tileTimesPath = argv[++i];
+        else if (arg == "--backend" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            ss >> backend;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+            numThreads = std::stoi(argv[++i]);
+        else if (arg == "--perf")
+            usePerfCounters = true;
+        else if (arg == "--profile" && i + 1 < argc)
+            profilePath = argv[++i];
+        else if (arg == "--profile-clock" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            ss >> profileClock;
+        }
+        else if (arg == "--heatmap" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            ss >> heatmapCost;
+            if (heatmapCost != Scene::NO_COST && heatmapCost != Scene::TIME && !Statistics::ENABLED) {
+                std::cerr << "Heatmaps of " << heatmapCost << " need a build with the CMake option RAYTRACE_STATS\n";
+                exit(1);
+            }
+        }
+        else
+            args.push_back(arg);
+    }
 
-    if (argc == 3)
-        jobs.emplace_back(RaytraceJob{argv[1], argv[2]});
-    else if ((argc == 2) && argv[1][0] == '0') {
+    if (args.size() == 2)
+        jobs.emplace_back(RaytraceJob{args[0], args[1]});
+    else if ((args.size() == 1) && args[0][0] == '0') {
         jobs = { {
             {"../scenes/spheres/spheres.sce",       "spheres.tga"},
             {"../scenes/cylinders/cylinders.sce",   "cylinders.tga"},
@@ -55,15 +152,49 @@ int main(int argc, char **argv)
         } };
     }
     else {
-        std::cerr << "Usage: " << argv[0] << " input.sce output.tga\n";
-        std::cerr << "Or: " << argv[0] << " 0\n";
+        std::cerr << "Usage: " << argv[0] << " [options] input.sce output.tga\n";
+        std::cerr << "Or: " << argv[0] << " [options] 0\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --linear         test all objects and triangles instead of using the BVHs\n";
+        std::cerr << "  --no-packets     trace primary rays one by one instead of in 2x2 packets\n";
+        std::cerr << "  --no-mesh-cache  always read the mesh files and build their BVHs\n";
+        std::cerr << "  --bvh <quality>  build the BVHs with median, binned (SAH), or sweep (SAH) splits\n";
+        std::cerr << "  --accel <a>      accelerate the scene with a bvh, a uniform grid, or auto (default)\n";
+        std::cerr << "  --tile-size <n>  render in tiles of n x n pixels (default 16)\n";
+        std::cerr << "  --tile-order <o> render tiles in scanline, morton (default), or spiral order\n";
+        std::cerr << "  --tile-times <f> write the time spent per tile to the CSV file f\n";
+        std::cerr << "  --backend <b>    render with openmp (default), threads (std::thread pool), or serial\n";
+        std::cerr << "  --threads <n>    number of render threads (default: one per core)\n";
+        std::cerr << "  --heatmap <c>    write the time, rays, boxes, or tests per pixel to output_heatmap.tga\n";
+        std::cerr << "  --perf           count cycles, instructions, cache and branch misses per phase and thread\n";
+        std::cerr << "  --profile <f>    print the time spent per phase and write a Chrome trace to the file f\n";
+        std::cerr << "  --profile-clock <c>  time the phases with the steady (default) or rdtsc clock\n";
         std::cerr << std::flush;
         exit(1);
     }
 
+    if (!profilePath.empty())
+        Profiler::enable(profileClock);
+
+    // without performance counters, e.g. if not permitted, render anyway
+    if (usePerfCounters) {
+        std::string message;
+        usePerfCounters = PerfCounters::enable(message);
+        if (!message.empty())
+            std::cerr << message << std::endl;
+    }
+
     for (const auto &job : jobs) {
         std::cout << "Read scene '" << job.scenePath << "'..." << std::flush;
-        Scene s(job.scenePath);
+        Scene s(job.scenePath, bvhQuality, useMeshCache);
+        s.setUseBVH(useBVH);
+        if (accelerator) s.setAccelerator(*accelerator);
+        s.setUsePackets(usePackets);
+        s.setTileSize(tileSize);
+        s.setTileOrder(tileOrder);
+        s.setBackend(backend);
+        s.setNumThreads(numThreads);
+        s.setHeatmap(heatmapCost);
         std::cout << "\ndone (" << s.numObjects() << " objects)\n";
 
         StopWatch timer;
@@ -72,9 +203,75 @@ int main(int argc, char **argv)
         auto image = s.render();
         timer.stop();
         std::cout << " done (" << timer << ")\n";
+        std::cout << "Meshes: loaded in " << s.meshLoadTime() << " ms ("
+                  << s.numCachedMeshes() << " from cache)\n";
+        std::cout << "BVH (" << s.getBVHQuality() << "): built in " << s.bvhBuildTime()
+                  << " ms, expected cost " << s.bvhCost() << " per ray\n";
+        if (s.getAccelerator() == Scene::GRID) {
+            const Grid &grid = s.getGrid();
+            std::cout << "Grid: " << grid.resolution(0) << "x" << grid.resolution(1) << "x"
+                      << grid.resolution(2) << " cells, " << grid.num_references() << " references, built in "
+                      << s.gridBuildTime() << " ms\n";
+        }
+
+        if (Statistics::ENABLED) {
+            const Statistics &stats = s.getStatistics();
+            const double rays = double(std::max(stats.rays(), uint64_t(1)));
+            std::cout << "Rays: " << stats.rays() << " (" << stats[Statistics::PRIMARY_RAYS] << " primary, "
+                      << stats[Statistics::REFLECTION_RAYS] << " reflection, "
+                      << stats[Statistics::SHADOW_RAYS] << " shadow), "
+                      << stats.rays() / timer.elapsed() / 1000.0 << " Mrays/s, "
+                      << 100.0 * stats[Statistics::HITS] / rays << "% hit\n";
+            std::cout << "Tests per ray: " << stats[Statistics::BOX_TESTS] / rays << " boxes, "
+                      << stats[Statistics::OBJECT_TESTS] / rays << " objects, "
+                      << stats[Statistics::TRIANGLE_TESTS] / rays << " triangles\n";
+        }
+
+        // spread of the tile times shows how well the work is balanced
+        std::vector<double> tileTimes;
+        for (const Tile &tile : s.getTiles())
+            tileTimes.push_back(tile.time);
+        std::sort(tileTimes.begin(), tileTimes.end());
+        std::cout << "Tiles (" << tileTimes.size() << " of " << tileSize << "x" << tileSize
+                  << ", " << tileOrder << "): min " << tileTimes.front()
+                  << " ms, median " << tileTimes[tileTimes.size() / 2]
+                  << " ms, max " << tileTimes.back() << " ms\n";
+
+        if (!tileTimesPath.empty()) {
+            std::ofstream ofs(tileTimesPath);
+            ofs << "x,y,width,height,ms\n";
+            for (const Tile &tile : s.getTiles())
+                ofs << tile.x0 << ',' << tile.y0 << ',' << tile.x1 - tile.x0 << ','
+                    << tile.y1 - tile.y0 << ',' << tile.time << '\n';
+        }
 
         std::cout << "Write image...";
-        image.write(job.outPath);
+        {
+            Profiler::Scope scope("write");
+            image.write(job.outPath);
+        }
         std::cout << "done\n";
+
+        if (heatmapCost != Scene::NO_COST) {
+            const std::vector<double> &cost = s.getHeatmap();
+            const std::string path = job.outPath.substr(0, job.outPath.rfind('.')) + "_heatmap.tga";
+            std::cout << "Heatmap (" << heatmapCost << (heatmapCost == Scene::TIME ? " in ns" : "")
+                      << " per pixel): mean " << std::accumulate(cost.begin(), cost.end(), 0.0) / cost.size()
+                      << ", max " << *std::max_element(cost.begin(), cost.end()) << "\n";
+            std::cout << "Write heatmap...";
+            heatmap_image(cost, image.width(), image.height()).write(path);
+            std::cout << "done (" << path << ")\n";
+        }
+    }
+
+    if (usePerfCounters)
+        PerfCounters::print_summary(std::cout);
+
+    if (!profilePath.empty()) {
+        Profiler::print_summary(std::cout);
+        if (Profiler::write_trace(profilePath))
+            std::cout << "Trace written to " << profilePath << " (open it in chrome://tracing or ui.perfetto.dev)\n";
+        else
+            std::cerr << "Cannot write " << profilePath << "\n";
     }
 }
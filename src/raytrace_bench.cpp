@@ -0,0 +1,263 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "Scene.h"
+
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <cmath>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// Median, minimum, and standard deviation of the times of one phase
+struct Timing
+{
+    double median = 0, min = 0, stddev = 0;
+};
+
+
+/// Summarize the times \c _ms (in ms) of the repetitions of a phase
+static Timing summarize(std::vector<double> _ms)
+{
+    Timing timing;
+    if (_ms.empty()) return timing;
+
+    std::sort(_ms.begin(), _ms.end());
+    const size_t n = _ms.size();
+    timing.median = n % 2 ? _ms[n / 2] : 0.5 * (_ms[n / 2 - 1] + _ms[n / 2]);
+    timing.min    = _ms.front();
+
+    const double mean = std::accumulate(_ms.begin(), _ms.end(), 0.0) / n;
+    double sum = 0;
+    for (double t : _ms) sum += (t - mean) * (t - mean);
+    timing.stddev = n > 1 ? std::sqrt(sum / (n - 1)) : 0.0;
+    return timing;
+}
+
+
+/// Results of one scene
+struct Result
+{
+    std::string name, path;
+    unsigned int width = 0, height = 0;
+    size_t objects = 0;
+    std::string accelerator; // "bvh", "grid", or "linear"
+    uint64_t rays = 0;
+    Timing load, build, render;
+};
+
+
+/// Quote \c _s as a JSON string
+static std::string json_string(const std::string &_s)
+{
+    std::string quoted = "\"";
+    for (char c : _s) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+
+/// Text that \c _value is written as by its operator<<
+template <class T>
+static std::string to_string(const T &_value)
+{
+    std::ostringstream ss;
+    ss << _value;
+    return ss.str();
+}
+
+
+/// Write \c _timing as a JSON object
+static std::ostream& operator<<(std::ostream &os, const Timing &_timing)
+{
+    return os << "{\"median\": " << _timing.median << ", \"min\": " << _timing.min
+              << ", \"stddev\": " << _timing.stddev << "}";
+}
+
+
+/// Program entry point. Renders every scene of a directory several times and
+/// reports the times of loading, building, and rendering each of them.
+int main(int argc, char **argv)
+{
+    std::string scenesPath = "../scenes";
+    std::string jsonPath = "raytrace_bench.json";
+    unsigned int repetitions = 5;
+    unsigned int warmups = 1;
+    unsigned int numThreads = 0;
+    bool useMeshCache = true;
+    bool useBVH = true;
+    std::optional<BVH::Quality> bvhQuality;
+    std::optional<Scene::Accelerator> accelerator;
+    std::vector<std::string> only;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--scenes" && i + 1 < argc)
+            scenesPath = argv[++i];
+        else if (arg == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (arg == "--repetitions" && i + 1 < argc)
+            repetitions = std::max(std::stoi(argv[++i]), 1);
+        else if (arg == "--warmup" && i + 1 < argc)
+            warmups = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            numThreads = std::stoi(argv[++i]);
+        else if (arg == "--no-mesh-cache")
+            useMeshCache = false;
+        else if (arg == "--linear")
+            useBVH = false;
+        else if (arg == "--bvh" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            bvhQuality.emplace();
+            ss >> *bvhQuality;
+        }
+        else if (arg == "--accel" && i + 1 < argc) {
+            std::istringstream ss(argv[++i]);
+            accelerator.emplace();
+            ss >> *accelerator;
+        }
+        else if (arg[0] != '-')
+            only.push_back(arg);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [options] [scene names]\n";
+            std::cerr << "Renders every scene (or the given ones) of the scenes directory and writes\n";
+            std::cerr << "the median, minimum, and standard deviation of the times to a JSON file.\n";
+            std::cerr << "Options:\n";
+            std::cerr << "  --scenes <dir>      directory with one subdirectory per scene (default ../scenes)\n";
+            std::cerr << "  --json <file>       where to write the results (default raytrace_bench.json)\n";
+            std::cerr << "  --repetitions <n>   measured runs per scene (default 5)\n";
+            std::cerr << "  --warmup <n>        unmeasured runs per scene before them (default 1)\n";
+            std::cerr << "  --threads <n>       number of render threads (default: one per core)\n";
+            std::cerr << "  --no-mesh-cache     always read the mesh files and build their BVHs\n";
+            std::cerr << "  --linear            test all objects and triangles instead of using the BVHs\n";
+            std::cerr << "  --bvh <quality>     build the BVHs with median, binned (SAH), or sweep (SAH) splits\n";
+            std::cerr << "  --accel <a>         accelerate the scenes with a bvh, a uniform grid, or auto\n";
+            std::cerr << "                      (default: as set in the scene files)\n";
+            std::cerr << std::flush;
+            exit(1);
+        }
+    }
+
+    // every <dir>/<name>/<name>.sce, in alphabetical order
+    std::vector<std::pair<std::string, std::string>> scenes;
+    for (const auto &entry : std::filesystem::directory_iterator(scenesPath)) {
+        const std::string name = entry.path().filename().string();
+        const std::filesystem::path sce = entry.path() / (name + ".sce");
+        if (std::filesystem::exists(sce) && (only.empty() || std::find(only.begin(), only.end(), name) != only.end()))
+            scenes.emplace_back(name, sce.string());
+    }
+    std::sort(scenes.begin(), scenes.end());
+
+    std::cout << "Benchmark of " << scenes.size() << " scenes, " << warmups << " warm-up and "
+              << repetitions << " measured runs each (times in ms: median / min / stddev)\n";
+    std::cout << std::fixed << std::setprecision(1);
+
+    std::vector<Result> results;
+    for (const auto &[name, path] : scenes) {
+        Result result;
+        result.name = name;
+        result.path = path;
+
+        std::vector<double> load, build, render;
+        for (unsigned int run = 0; run < warmups + repetitions; ++run) {
+            // the scene reports its progress on std::cout, which would hide the results
+            std::cout.setstate(std::ios::failbit);
+
+            StopWatch timer;
+            timer.start();
+            Scene s(path, bvhQuality, useMeshCache);
+            s.setUseBVH(useBVH);
+            if (accelerator) s.setAccelerator(*accelerator);
+            const double sceneTime = timer.stop();
+            s.setNumThreads(numThreads);
+
+            timer.start();
+            s.render();
+            const double renderTime = timer.stop();
+
+            std::cout.clear();
+
+            if (run < warmups) continue;
+
+            // building the scene's BVH or grid is part of reading the scene
+            const double buildTime = s.bvhBuildTime() + (s.getAccelerator() == Scene::GRID ? s.gridBuildTime() : 0.0);
+            load.push_back(sceneTime - buildTime);
+            build.push_back(buildTime);
+            render.push_back(renderTime);
+
+            result.width   = s.getCamera().width;
+            result.height  = s.getCamera().height;
+            result.objects = s.numObjects();
+            result.accelerator = useBVH ? to_string(s.getAccelerator()) : "linear";
+            result.rays    = Statistics::ENABLED ? s.getStatistics().rays()
+                                                 : uint64_t(result.width) * result.height;
+        }
+        result.load   = summarize(load);
+        result.build  = summarize(build);
+        result.render = summarize(render);
+        results.push_back(result);
+
+        std::cout << std::left << std::setw(12) << name << std::setw(7) << result.accelerator << std::right
+                  << "  load "   << std::setw(7) << result.load.median   << " / " << std::setw(7) << result.load.min   << " / " << std::setw(5) << result.load.stddev
+                  << "  build "  << std::setw(7) << result.build.median  << " / " << std::setw(7) << result.build.min  << " / " << std::setw(5) << result.build.stddev
+                  << "  render " << std::setw(7) << result.render.median << " / " << std::setw(7) << result.render.min << " / " << std::setw(5) << result.render.stddev
+                  << "  " << std::setprecision(3) << result.rays / result.render.median / 1000.0 << std::setprecision(1)
+                  << " Mrays/s" << std::endl;
+    }
+
+    if (!Statistics::ENABLED)
+        std::cout << "Mrays/s counts primary rays only; build with RAYTRACE_STATS to count all rays.\n";
+
+    // machine readable results, e.g. to compare commits
+    std::ofstream ofs(jsonPath);
+    if (!ofs) {
+        std::cerr << "Cannot write " << jsonPath << std::endl;
+        exit(1);
+    }
+    ofs << std::setprecision(6);
+    ofs << "{\n";
+    ofs << "  \"precision\": " << json_string(RAYTRACE_FLOAT ? "float" : "double") << ",\n";
+    ofs << "  \"openmp\": " << (HAVE_OPENMP ? "true" : "false") << ",\n";
+    ofs << "  \"all_rays_counted\": " << (Statistics::ENABLED ? "true" : "false") << ",\n";
+    ofs << "  \"threads\": " << numThreads << ",\n";
+    ofs << "  \"accel\": " << (accelerator ? json_string(to_string(*accelerator)) : "null") << ",\n";
+    ofs << "  \"linear\": " << (useBVH ? "false" : "true") << ",\n";
+    ofs << "  \"bvh\": " << (bvhQuality ? json_string(to_string(*bvhQuality)) : "null") << ",\n";
+    ofs << "  \"mesh_cache\": " << (useMeshCache ? "true" : "false") << ",\n";
+    ofs << "  \"warmup\": " << warmups << ",\n";
+    ofs << "  \"repetitions\": " << repetitions << ",\n";
+    ofs << "  \"scenes\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        ofs << (i ? "," : "") << "\n    {\"name\": " << json_string(r.name) << ", \"file\": " << json_string(r.path)
+            << ", \"width\": " << r.width << ", \"height\": " << r.height << ", \"objects\": " << r.objects
+            << ", \"accel\": " << json_string(r.accelerator)
+            << ",\n     \"load_ms\": " << r.load << ",\n     \"build_ms\": " << r.build
+            << ",\n     \"render_ms\": " << r.render
+            << ",\n     \"rays\": " << r.rays << ", \"mrays_per_s\": " << r.rays / r.render.median / 1000.0 << "}";
+    }
+    ofs << "\n  ]\n}\n";
+    std::cout << "Results written to " << jsonPath << std::endl;
+}